@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "falcon/utils/hash.h"
+
+namespace falcon {
+namespace detail {
+constexpr bool kLittleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+} // namespace detail
+
+/**
+ * Helpers for reading and writing unsigned integers in little endian byte
+ * order regardless of the host, so that files are portable across platforms.
+ */
+template <class T> void storeLE(uint8_t *buf, T val) {
+  static_assert(std::is_unsigned_v<T>);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    buf[i] = (uint8_t)(val >> (8 * i));
+  }
+}
+
+template <class T> T loadLE(const uint8_t *buf) {
+  static_assert(std::is_unsigned_v<T>);
+  T val = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    val |= ((T)buf[i]) << (8 * i);
+  }
+  return val;
+}
+
+template <class T> void writeLE(std::ostream &os, T val) {
+  uint8_t buf[sizeof(T)];
+  storeLE(buf, val);
+  os.write(reinterpret_cast<const char *>(buf), sizeof(T));
+}
+
+template <class T> T readLE(std::istream &is) {
+  uint8_t buf[sizeof(T)];
+  if (!is.read(reinterpret_cast<char *>(buf), sizeof(T))) {
+    throw std::runtime_error("Unexpected end of file");
+  }
+  return loadLE<T>(buf);
+}
+
+namespace detail {
+/**
+ * A 64 bit checksum of buf[0..n) that, like the rest of this file, depends
+ * only on the bytes and not on the host's byte order. Words are folded into
+ * four independent lanes so that the mixing of consecutive words overlaps.
+ */
+inline uint64_t checksum64(const uint8_t *buf, size_t n) {
+  uint64_t lanes[4] = {0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full,
+                       0x165667b19e3779f9ull, 0x27d4eb2f165667c5ull};
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    for (size_t j = 0; j < 4; ++j) {
+      lanes[j] = mix64(lanes[j] ^ loadLE<uint64_t>(buf + i + 8 * j));
+    }
+  }
+  uint64_t h = n;
+  for (auto lane : lanes) {
+    h = mix64(h ^ lane);
+  }
+  for (; i < n; ++i) {
+    h = mix64(h ^ buf[i]);
+  }
+  return h;
+}
+} // namespace detail
+} // namespace falcon
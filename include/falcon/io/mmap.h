@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace falcon {
+/**
+ * A read only, shared memory mapping of an entire file. Pages are loaded
+ * lazily by the kernel so mapping a large file is cheap; the mapping is
+ * removed when the MappedFile is destroyed.
+ */
+class MappedFile {
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+
+  [[noreturn]] static void fail(const std::string &what,
+                                const std::string &fname) {
+    std::stringstream ss;
+    ss << what << ' ' << fname << ": " << std::strerror(errno);
+    throw std::runtime_error(ss.str());
+  }
+
+public:
+  explicit MappedFile() = default;
+  explicit MappedFile(const std::string &fname) {
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fail("Could not open", fname);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      ::close(fd);
+      fail("Could not stat", fname);
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        fail("Could not mmap", fname);
+      }
+      data_ = static_cast<const uint8_t *>(addr);
+    }
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other)
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+  MappedFile &operator=(MappedFile &&other) {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  ~MappedFile() {
+    if (data_) {
+      ::munmap(const_cast<uint8_t *>(data_), size_);
+    }
+  }
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+};
+} // namespace falcon
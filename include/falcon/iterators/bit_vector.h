@@ -1,26 +1,164 @@
+#pragma once
+
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <memory>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 
 namespace falcon {
-template <size_t nBits> class BitVector {
-  static constexpr size_t nBytes = nBits << 3;
-  uint8_t *buf_;
+namespace detail {
+/**
+ * Returns the position of the k-th (0-indexed) set bit of w, which must have
+ * more than k bits set.
+ */
+inline size_t selectInWord(uint64_t w, size_t k) {
+#ifdef __BMI2__
+  return __builtin_ctzll(_pdep_u64(((uint64_t)1) << k, w));
+#else
+  for (; k; --k) {
+    w &= w - 1;
+  }
+  return __builtin_ctzll(w);
+#endif
+}
+} // namespace detail
+
+/**
+ * A fixed size bitset backed by 64 bit words and zero initialized.
+ *
+ * If nBits is 0 the size is instead given at runtime, e.g.
+ * BitVector<> bv(n). Bulk operations work a word at a time and are written
+ * as plain loops over the words so that the compiler vectorizes them (AVX2
+ * with -mavx2); popcount uses __builtin_popcountll (POPCNT with -mpopcnt).
+ *
+ * Bits past size() in the last word are always 0. Binary operations require
+ * both vectors to have the same size.
+ */
+template <size_t nBits = 0> class BitVector {
+  size_t nBits_;
+  std::unique_ptr<uint64_t[]> words_;
+
+  static size_t wordsFor(size_t bits) { return (bits + 63) >> 6; }
 
 public:
-  BitVector() { buf_ = (uint8_t *)std::malloc(nBytes); }
-  ~BitVector() { std::free(buf_); }
+  explicit BitVector() : BitVector(nBits) {}
+  explicit BitVector(size_t bits)
+      : nBits_(bits), words_(new uint64_t[wordsFor(bits)]()) {}
+
+  BitVector(const BitVector &other) : BitVector(other.nBits_) {
+    std::copy(other.words_.get(), other.words_.get() + nWords(),
+              words_.get());
+  }
+  BitVector(BitVector &&other) = default;
+
+  BitVector &operator=(const BitVector &other) {
+    if (this != &other) {
+      *this = BitVector(other);
+    }
+    return *this;
+  }
+  BitVector &operator=(BitVector &&other) = default;
+
+  size_t size() const { return nBits_; }
+  size_t nWords() const { return wordsFor(nBits_); }
+  uint64_t *data() { return words_.get(); }
+  const uint64_t *data() const { return words_.get(); }
+
+  bool operator[](size_t i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+
+  void setBit(size_t i) { words_[i >> 6] |= ((uint64_t)1) << (i & 63); }
+
+  void clearBit(size_t i) { words_[i >> 6] &= ~(((uint64_t)1) << (i & 63)); }
+
+  void reset() { std::fill(words_.get(), words_.get() + nWords(), 0); }
+
+  size_t popcount() const {
+    size_t n = 0;
+    const uint64_t *words = words_.get();
+    for (size_t i = 0; i < nWords(); ++i) {
+      n += __builtin_popcountll(words[i]);
+    }
+    return n;
+  }
+
+  BitVector &operator&=(const BitVector &other) {
+    uint64_t *__restrict words = words_.get();
+    const uint64_t *__restrict otherWords = other.words_.get();
+    for (size_t i = 0; i < nWords(); ++i) {
+      words[i] &= otherWords[i];
+    }
+    return *this;
+  }
+
+  BitVector &operator|=(const BitVector &other) {
+    uint64_t *__restrict words = words_.get();
+    const uint64_t *__restrict otherWords = other.words_.get();
+    for (size_t i = 0; i < nWords(); ++i) {
+      words[i] |= otherWords[i];
+    }
+    return *this;
+  }
+
+  BitVector &operator^=(const BitVector &other) {
+    uint64_t *__restrict words = words_.get();
+    const uint64_t *__restrict otherWords = other.words_.get();
+    for (size_t i = 0; i < nWords(); ++i) {
+      words[i] ^= otherWords[i];
+    }
+    return *this;
+  }
+
+  /**
+   * Returns the index of the first set bit at or after i, or size() if there
+   * is none.
+   */
+  size_t findNext(size_t i) const {
+    if (i >= nBits_) {
+      return nBits_;
+    }
+    size_t w = i >> 6;
+    uint64_t word = words_[w] & (~((uint64_t)0) << (i & 63));
+    while (word == 0) {
+      if (++w == nWords()) {
+        return nBits_;
+      }
+      word = words_[w];
+    }
+    return (w << 6) + __builtin_ctzll(word);
+  }
 
-  bool operator[](size_t i) const {
-    size_t bitIdx = i & 7;
-    size_t bufIdx = i >> 3;
-    return (buf_[bufIdx] >> (7 - bitIdx)) & 1;
+  /**
+   * Returns the number of set bits in [0, i). O(i / 64).
+   */
+  size_t rank(size_t i) const {
+    size_t n = 0;
+    const size_t w = i >> 6;
+    for (size_t j = 0; j < w; ++j) {
+      n += __builtin_popcountll(words_[j]);
+    }
+    if (i & 63) {
+      n += __builtin_popcountll(words_[w] & ((((uint64_t)1) << (i & 63)) - 1));
+    }
+    return n;
   }
 
-  void setBit(size_t i) {
-    size_t bitIdx = i & 7;
-    size_t bufIdx = i >> 3;
-    auto block = buf_[bufIdx];
-    buf_[bufIdx] = block | (1 << (7 - bitIdx));
+  /**
+   * Returns the index of the k-th (0-indexed) set bit, or size() if fewer
+   * than k + 1 bits are set. O(size() / 64).
+   */
+  size_t select(size_t k) const {
+    for (size_t w = 0; w < nWords(); ++w) {
+      const size_t n = __builtin_popcountll(words_[w]);
+      if (k < n) {
+        return (w << 6) + detail::selectInWord(words_[w], k);
+      }
+      k -= n;
+    }
+    return nBits_;
   }
 };
 } // namespace falcon
@@ -1,53 +1,68 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 
 // TODO fix bidirectional iterator; specifically, -- does not work because it
 // just has nullptr
 namespace falcon {
 template <class TreeNode> class InOrderIt {
-  TreeNode *next_ = nullptr;
+  const TreeNode *next_ = nullptr;
 
 public:
   typedef std::bidirectional_iterator_tag iterator_category;
+  typedef typename TreeNode::data_t value_type;
+  typedef std::ptrdiff_t difference_type;
   typedef typename TreeNode::data_t *pointer;
   typedef typename TreeNode::data_t &reference;
 
   explicit InOrderIt() = default;
-  explicit InOrderIt(const TreeNode &node) {
-    auto next_ = &node;
 
+  /**
+   * Starts at the smallest node of the subtree rooted at node.
+   */
+  explicit InOrderIt(const TreeNode &node) : next_(&node) {
     while (next_->left) {
-      next_ = next_->left.get();
+      next_ = next_->left;
     }
   }
 
+  /**
+   * Starts at node itself, or at the end if node is nullptr.
+   */
+  explicit InOrderIt(const TreeNode *node) : next_(node) {}
+
   InOrderIt &operator++() {
-    if (next_->parent == nullptr || next_->isLeft()) {
-      if (next_->right) {
-        next_ = next_->right.get();
-        while (next_->left) {
-          next_ = next_->left.get();
-        }
-      } else {
-        next_ = next_->parent;
+    if (next_->right) {
+      next_ = next_->right;
+      while (next_->left) {
+        next_ = next_->left;
       }
     } else {
-      do {
+      while (next_->parent && !next_->isLeft()) {
         next_ = next_->parent;
-      } while (next_->parent && !next_->isLeft());
+      }
       next_ = next_->parent;
     }
     return *this;
   }
 
+  InOrderIt operator++(int) {
+    auto ret = *this;
+    ++*this;
+    return ret;
+  }
+
   InOrderIt &operator--() {
     if (next_->left) {
-      next_ = next_->left.get();
+      next_ = next_->left;
       while (next_->right) {
-        next_ = next_->right.get();
+        next_ = next_->right;
       }
     } else {
+      while (next_->parent && next_->isLeft()) {
+        next_ = next_->parent;
+      }
       next_ = next_->parent;
     }
     return *this;
@@ -88,9 +103,9 @@ public:
 
   PreOrderIt &operator++() {
     if (next_->left) {
-      next_ = next_->left.get();
+      next_ = next_->left;
     } else if (next_->right) {
-      next_ = next_->right.get();
+      next_ = next_->right;
     } else {
       next_ = nullptr;
     }
@@ -105,9 +120,9 @@ public:
       next_ = next_->parent;
       while (1) {
         if (next_->right) {
-          next_ = next_->right.get();
+          next_ = next_->right;
         } else if (next_->left) {
-          next_ = next_->left.get();
+          next_ = next_->left;
         } else {
           break;
         }
@@ -157,9 +172,9 @@ public:
 
     while (1) {
       if (next_->left) {
-        next_ = next_->left.get();
+        next_ = next_->left;
       } else if (next_->right) {
-        next_ = next_->right.get();
+        next_ = next_->right;
       } else {
         break;
       }
@@ -170,12 +185,12 @@ public:
     if (next_->isLeft()) {
       next_ = next_->parent;
       if (next_->right) {
-        next_ = next_->right.get();
+        next_ = next_->right;
         while (1) {
           if (next_->left) {
-            next_ = next_->left.get();
+            next_ = next_->left;
           } else if (next_->right) {
-            next_ = next_->right.get();
+            next_ = next_->right;
           } else {
             break;
           }
@@ -190,9 +205,9 @@ public:
 
   PostOrderIt &operator--() {
     if (next_->right) {
-      next_ = next_->right.get();
+      next_ = next_->right;
     } else {
-      next_ = next_->left.get();
+      next_ = next_->left;
     }
 
     return *this;
@@ -227,10 +242,31 @@ class Traversal_ {
 
 public:
   explicit Traversal_(const TreeNode &node) : node_(&node) {}
+  // An empty traversal if node is nullptr.
+  explicit Traversal_(const TreeNode *node) : node_(node) {}
 
-  TraversalIt<TreeNode> begin() { return TraversalIt<TreeNode>(*node_); }
+  TraversalIt<TreeNode> begin() {
+    if (node_ == nullptr) {
+      return TraversalIt<TreeNode>();
+    }
+    return TraversalIt<TreeNode>(*node_);
+  }
   TraversalIt<TreeNode> end() { return TraversalIt<TreeNode>(); }
 };
+
+/**
+ * The half open range [begin, end) of an iterator.
+ */
+template <class It> class IteratorRange {
+  It begin_;
+  It end_;
+
+public:
+  explicit IteratorRange(It begin, It end) : begin_(begin), end_(end) {}
+
+  It begin() const { return begin_; }
+  It end() const { return end_; }
+};
 } // namespace detail
 
 // These are the traversal types
@@ -1,41 +1,333 @@
+#pragma once
+
 #include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
+#include "falcon/io/binary.h"
+#include "falcon/io/mmap.h"
 #include "falcon/iterators/bit_vector.h"
+#include "falcon/utils/hash.h"
+#include "falcon/utils/utils.h"
 
 namespace falcon {
 namespace detail {
 constexpr size_t kDefaultNBits = 1 << 20;
 constexpr uint64_t kDefaultK = 8;
+
+// Odd multipliers used to derive the per word bit positions of a blocked
+// bloom filter from one 32 bit hash (the same salts as Parquet's split block
+// bloom filter).
+constexpr std::array<uint32_t, 8> kBlockSalts = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+struct alignas(64) BloomBlock {
+  uint64_t words[8] = {};
+};
+
+/**
+ * Derives the k probe positions of a key from a single 64 bit hash as
+ * h1 + i * h2 (Kirsch & Mitzenmacher), which gives the same asymptotic false
+ * positive rate as k independent hashes.
+ */
+struct DoubleHash {
+  uint64_t h1;
+  uint64_t h2;
+
+  explicit DoubleHash(uint64_t hash) : h1(hash), h2(mix64(hash) | 1) {}
+
+  uint64_t operator()(uint64_t i) const { return h1 + i * h2; }
+};
+
+/**
+ * On disk a BloomFilter is this 24 byte header followed by its bit vector as
+ * little endian 64 bit words (so the words are 8 byte aligned in the file):
+ *
+ *   "FBLF" | u32 version | u64 nBits | u64 k | u64 words[(nBits + 63) / 64]
+ */
+constexpr char kBloomMagic[4] = {'F', 'B', 'L', 'F'};
+// Version 1 probed with Hash(0), ..., Hash(k - 1) rather than DoubleHash.
+constexpr uint32_t kBloomVersion = 2;
+constexpr size_t kBloomHeaderBytes = 24;
+
+/**
+ * Throws unless header (of which size bytes are valid) describes a filter with
+ * the given nBits and k, followed by all of its words.
+ */
+inline void checkBloomHeader(const uint8_t *header, size_t size, size_t nBits,
+                             uint64_t k, const std::string &fname) {
+  std::stringstream ss;
+  if (size < kBloomHeaderBytes ||
+      !std::equal(kBloomMagic, kBloomMagic + 4, header)) {
+    ss << fname << " is not a bloom filter";
+  } else if (loadLE<uint32_t>(header + 4) != kBloomVersion) {
+    ss << "Bloom filter version " << loadLE<uint32_t>(header + 4) << " in "
+       << fname << " is not supported";
+  } else if (loadLE<uint64_t>(header + 8) != nBits ||
+             loadLE<uint64_t>(header + 16) != k) {
+    ss << "nBits and k from file " << loadLE<uint64_t>(header + 8) << ", "
+       << loadLE<uint64_t>(header + 16) << " do not match " << nBits << ", "
+       << k;
+  } else if (size < kBloomHeaderBytes + ((nBits + 63) >> 6) * 8) {
+    ss << fname << " is truncated";
+  } else {
+    return;
+  }
+  throw std::runtime_error(ss.str());
+}
 } // namespace detail
 
+/**
+ * A bloom filter of nBits bits with k probes per key. Each key is hashed once
+ * with Hash(0) and its probes are derived with detail::DoubleHash.
+ */
 template <class Key, class Hash, size_t nBits = detail::kDefaultNBits,
           uint64_t k = detail::kDefaultK>
 class BloomFilter {
   BitVector<nBits> bitVector_;
-  std::array<Hash, k> hashFunctions_;
+  Hash hash_;
 
 public:
-  explicit BloomFilter() {
-    for (int i = 0; i < k; ++i) {
-      hashFunctions_[i] = Hash(i);
+  explicit BloomFilter() : hash_(0) {}
+
+  void insert(const Key &key) { insertHash(hash_(key)); }
+
+  /**
+   * Same as insert(key) for a hash that is Hash(0)(key), e.g. from
+   * hashBatch.
+   */
+  void insertHash(uint64_t hash) {
+    detail::DoubleHash probe(hash);
+    for (uint64_t i = 0; i < k; ++i) {
+      bitVector_.setBit(probe(i) % nBits);
+    }
+  }
+
+  void insertHashes(const uint64_t *hashes, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      insertHash(hashes[i]);
     }
   }
 
-  void insert(const Key &key) {
+  bool find(const Key &key) const { return findHash(hash_(key)); }
+
+  bool findHash(uint64_t hash) const {
+    detail::DoubleHash probe(hash);
     for (uint64_t i = 0; i < k; ++i) {
-      uint64_t bitIdx = hashFunctions_[i](key) % nBits;
-      bitVector_.setBit(bitIdx);
+      if (!bitVector_[probe(i) % nBits]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * After merging, this filter contains every key that was inserted into
+   * either filter. Both filters must use the same Hash seeds.
+   */
+  void merge(const BloomFilter &other) { bitVector_ |= other.bitVector_; }
+
+  /**
+   * After intersecting, this filter contains every key that was inserted into
+   * both filters. The false positive rate is at least as high as that of a
+   * filter built from the intersection directly.
+   */
+  void intersect(const BloomFilter &other) { bitVector_ &= other.bitVector_; }
+
+  double fillRatio() const { return (double)bitVector_.popcount() / nBits; }
+
+  /**
+   * The probability that find returns true for a key that was never inserted,
+   * given how full the filter currently is.
+   */
+  double falsePositiveRate() const { return std::pow(fillRatio(), k); }
+
+  /**
+   * Estimates the number of distinct keys inserted (Swamidass & Baldi).
+   */
+  double estimateSize() const {
+    return -(double)nBits / k * std::log1p(-fillRatio());
+  }
+
+  void saveToDisk(const std::string &fname) const {
+    std::ofstream of(fname, std::ios::binary);
+    of.write(detail::kBloomMagic, 4);
+    writeLE(of, detail::kBloomVersion);
+    writeLE<uint64_t>(of, nBits);
+    writeLE<uint64_t>(of, k);
+    const uint64_t *words = bitVector_.data();
+    for (size_t i = 0; i < bitVector_.nWords(); ++i) {
+      writeLE(of, words[i]);
+    }
+    of.flush();
+    if (UNLIKELY(!of)) {
+      throw std::runtime_error("Could not write " + fname);
     }
   }
 
-  bool find(const Key &key) {
+  static BloomFilter<Key, Hash, nBits, k>
+  readFromDisk(const std::string &fname) {
+    std::ifstream infile(fname, std::ios::binary | std::ios::ate);
+    const size_t size = infile.tellg();
+    infile.seekg(0);
+    uint8_t header[detail::kBloomHeaderBytes] = {};
+    infile.read(reinterpret_cast<char *>(header), sizeof(header));
+    detail::checkBloomHeader(header, size, nBits, k, fname);
+    BloomFilter<Key, Hash, nBits, k> bf;
+    uint64_t *words = bf.bitVector_.data();
+    for (size_t i = 0; i < bf.bitVector_.nWords(); ++i) {
+      words[i] = readLE<uint64_t>(infile);
+    }
+    return bf;
+  }
+};
+
+/**
+ * A read only BloomFilter backed by a memory mapping of a file written by
+ * BloomFilter::saveToDisk. Opening one does no copying, so it is usable
+ * immediately regardless of the filter's size; pages are faulted in as
+ * finds touch them.
+ *
+ * Requires a little endian host, where the file's words can be used as is.
+ */
+template <class Key, class Hash, size_t nBits = detail::kDefaultNBits,
+          uint64_t k = detail::kDefaultK>
+class BloomFilterView {
+  MappedFile file_;
+  const uint64_t *words_;
+  Hash hash_;
+
+public:
+  explicit BloomFilterView(const std::string &fname)
+      : file_(fname), hash_(0) {
+    if (!detail::kLittleEndian) {
+      throw std::runtime_error("BloomFilterView requires a little endian host");
+    }
+    detail::checkBloomHeader(file_.data(), file_.size(), nBits, k, fname);
+    words_ = reinterpret_cast<const uint64_t *>(file_.data() +
+                                                detail::kBloomHeaderBytes);
+  }
+
+  bool find(const Key &key) const { return findHash(hash_(key)); }
+
+  bool findHash(uint64_t hash) const {
+    detail::DoubleHash probe(hash);
     for (uint64_t i = 0; i < k; ++i) {
-      uint64_t bitIdx = hashFunctions_[i](key) % nBits;
-      if (!bitVector_[bitIdx]) {
+      uint64_t bitIdx = probe(i) % nBits;
+      if (!((words_[bitIdx >> 6] >> (bitIdx & 63)) & 1)) {
         return false;
       }
     }
     return true;
   }
 };
+
+/**
+ * A bloom filter where every key maps to a single 64 byte (cache line) block
+ * so that insert and find touch one line instead of k.
+ *
+ * Only Hash(0) is evaluated: its high 32 bits pick the block and its low 32
+ * bits are multiplied by k different salts, each product picking one bit of
+ * the block (one per word when k == 8). A find is then one AND-compare of the
+ * block against that mask, done with two AVX2 vptest instructions when
+ * available.
+ *
+ * Confining the bits to one block raises the false positive rate slightly
+ * compared to BloomFilter with the same nBits and k.
+ */
+template <class Key, class Hash, size_t nBits = detail::kDefaultNBits,
+          uint64_t k = detail::kDefaultK>
+class BlockedBloomFilter {
+  static_assert(1 <= k && k <= 8);
+  static_assert(nBits >= 512);
+  static constexpr size_t nBlocks = nBits / 512;
+
+  std::vector<detail::BloomBlock> blocks_;
+  Hash hash_;
+
+  const detail::BloomBlock &block(uint64_t hash) const {
+    return blocks_[((hash >> 32) * nBlocks) >> 32];
+  }
+
+  detail::BloomBlock &block(uint64_t hash) {
+    return blocks_[((hash >> 32) * nBlocks) >> 32];
+  }
+
+  static detail::BloomBlock mask(uint64_t hash) {
+    detail::BloomBlock mask;
+    const uint32_t h = hash;
+    for (size_t i = 0; i < k; ++i) {
+      const uint32_t bits = h * detail::kBlockSalts[i];
+      if constexpr (k == 8) {
+        mask.words[i] = ((uint64_t)1) << (bits >> 26);
+      } else {
+        // Spread fewer than 8 bits over the whole block rather than leaving
+        // words unused.
+        mask.words[bits >> 29] |= ((uint64_t)1) << ((bits >> 23) & 63);
+      }
+    }
+    return mask;
+  }
+
+public:
+  explicit BlockedBloomFilter() : blocks_(nBlocks), hash_(0) {}
+
+  void insert(const Key &key) { insertHash(hash_(key)); }
+
+  /**
+   * Same as insert(key) for a hash that is Hash(0)(key), e.g. from
+   * hashBatch.
+   */
+  void insertHash(uint64_t hash) {
+    auto &b = block(hash);
+    auto m = mask(hash);
+    for (size_t i = 0; i < 8; ++i) {
+      b.words[i] |= m.words[i];
+    }
+  }
+
+  /**
+   * Inserts every hash, prefetching the block of each a few hashes ahead.
+   */
+  void insertHashes(const uint64_t *hashes, size_t n) {
+    constexpr size_t kAhead = 8;
+    for (size_t i = 0; i < n; ++i) {
+      if (i + kAhead < n) {
+        __builtin_prefetch(&block(hashes[i + kAhead]), 1);
+      }
+      insertHash(hashes[i]);
+    }
+  }
+
+  bool find(const Key &key) const { return findHash(hash_(key)); }
+
+  bool findHash(uint64_t hash) const {
+    const auto &b = block(hash);
+    auto m = mask(hash);
+#ifdef __AVX2__
+    auto b0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(b.words));
+    auto b1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(b.words + 4));
+    auto m0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(m.words));
+    auto m1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(m.words + 4));
+    // testc(b, m) is 1 iff (~b & m) == 0, i.e. every bit of m is set in b.
+    return _mm256_testc_si256(b0, m0) & _mm256_testc_si256(b1, m1);
+#else
+    uint64_t missing = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      missing |= m.words[i] & ~b.words[i];
+    }
+    return missing == 0;
+#endif
+  }
+};
 } // namespace falcon
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <mutex>
+
+#include "falcon/sets/dense_set.h"
+#include "falcon/utils/hash.h"
+
+namespace falcon {
+/**
+ * A thread safe set made of 2^LogShards independently locked DenseSets.
+ *
+ * A key's shard is picked by the high bits of its (mixed) hash, while each
+ * shard places keys by the low bits, so the two choices are independent.
+ * Each shard grows on its own, so a resize only blocks the threads touching
+ * that one shard. Shards are cache line aligned so that neighbouring locks do
+ * not false share.
+ */
+template <class Key, size_t LogShards = 6, class Hash = std::hash<Key>,
+          class Eq = std::equal_to<Key>>
+class ConcurrentDenseSet {
+  static_assert(0 < LogShards && LogShards <= 16);
+  static constexpr size_t kShards = ((size_t)1) << LogShards;
+
+  struct alignas(64) Shard {
+    mutable std::mutex mu;
+    DenseSet<Key, 1, Hash, Eq> set;
+  };
+
+  std::array<Shard, kShards> shards_;
+  Hash hasher_;
+
+  Shard &shard(uint64_t hash) {
+    return shards_[detail::mix64(hash) >> (64 - LogShards)];
+  }
+  const Shard &shard(uint64_t hash) const {
+    return shards_[detail::mix64(hash) >> (64 - LogShards)];
+  }
+
+public:
+  /**
+   * Returns true iff k was not already in the set.
+   */
+  bool insert(const Key &k) {
+    auto hash = hasher_(k);
+    auto &s = shard(hash);
+    std::lock_guard<std::mutex> lock(s.mu);
+    const size_t before = s.set.size();
+    s.set.insert(k, hash);
+    return s.set.size() != before;
+  }
+
+  bool find(const Key &k) const {
+    auto hash = hasher_(k);
+    auto &s = shard(hash);
+    std::lock_guard<std::mutex> lock(s.mu);
+    return s.set.find(k, hash);
+  }
+
+  size_t erase(const Key &k) {
+    auto hash = hasher_(k);
+    auto &s = shard(hash);
+    std::lock_guard<std::mutex> lock(s.mu);
+    return s.set.erase(k, hash);
+  }
+
+  /**
+   * Locks one shard at a time, so under concurrent modification this is only
+   * a snapshot of each shard rather than of the whole set.
+   */
+  size_t size() const {
+    size_t n = 0;
+    for (const auto &s : shards_) {
+      std::lock_guard<std::mutex> lock(s.mu);
+      n += s.set.size();
+    }
+    return n;
+  }
+};
+} // namespace falcon
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "falcon/io/binary.h"
+#include "falcon/sets/hll.h"
+
+namespace falcon {
+/**
+ * A HyperLogLog that many threads insert into at once.
+ *
+ * Every thread inserts through its own Inserter, which owns a dense set of
+ * registers that only that thread writes, so inserting never takes a lock or
+ * contends on a cache line. A background thread merges all of them into the
+ * global registers every mergeInterval, and count merges them once more
+ * before estimating, so it reflects every insert that happened before it.
+ * Destroying an Inserter merges its registers one last time and frees them.
+ *
+ * Thread local registers are 64 bit atomics holding 8 registers each. The
+ * owner updates them with relaxed loads and stores, which compile to plain
+ * moves on x86, and the merger reads them the same way; merging never blocks
+ * an inserter.
+ */
+template <class Key, template <typename> class Hash, size_t LogM = 8>
+class ConcurrentHyperLogLog {
+  static_assert(3 <= LogM && LogM <= 16);
+  static constexpr size_t M = ((size_t)1) << LogM;
+  static constexpr size_t kWords = M / 8;
+
+  struct alignas(64) Local {
+    std::unique_ptr<std::atomic<uint64_t>[]> words{
+        new std::atomic<uint64_t>[kWords]()};
+  };
+
+  // Guards locals_ and registers_. Never taken by insert.
+  mutable std::mutex mu_;
+  std::vector<std::unique_ptr<Local>> locals_;
+  // Merged into by const methods, which only bring it up to date.
+  mutable std::vector<uint8_t> registers_ = std::vector<uint8_t>(M);
+
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread merger_;
+
+  void mergeLocked(const Local &local) const {
+    uint8_t buf[M];
+    for (size_t i = 0; i < kWords; ++i) {
+      storeLE(buf + 8 * i, local.words[i].load(std::memory_order_relaxed));
+    }
+    detail::maxBytes(registers_.data(), buf, M);
+  }
+
+  void mergeLocked() const {
+    for (const auto &local : locals_) {
+      mergeLocked(*local);
+    }
+  }
+
+  // Folds an Inserter's registers into registers_ and frees them.
+  void retire(Local *local) {
+    std::lock_guard<std::mutex> lock(mu_);
+    mergeLocked(*local);
+    auto it = std::find_if(locals_.begin(), locals_.end(),
+                           [local](const auto &l) { return l.get() == local; });
+    std::swap(*it, locals_.back());
+    locals_.pop_back();
+  }
+
+public:
+  /**
+   * Inserts into its ConcurrentHyperLogLog from a single thread. It is
+   * move-only and must be destroyed before its ConcurrentHyperLogLog;
+   * destroying it merges its inserts into the global registers.
+   */
+  class Inserter {
+    ConcurrentHyperLogLog *owner_ = nullptr;
+    Local *local_ = nullptr;
+    Hash<Key> hasher_;
+
+    explicit Inserter(ConcurrentHyperLogLog *owner, Local *local)
+        : owner_(owner), local_(local) {}
+
+    void reset() {
+      if (local_) {
+        owner_->retire(local_);
+        local_ = nullptr;
+      }
+    }
+
+    friend class ConcurrentHyperLogLog;
+
+  public:
+    Inserter(Inserter &&other)
+        : owner_(other.owner_), local_(std::exchange(other.local_, nullptr)) {}
+
+    Inserter &operator=(Inserter &&other) {
+      if (this != &other) {
+        reset();
+        owner_ = other.owner_;
+        local_ = std::exchange(other.local_, nullptr);
+      }
+      return *this;
+    }
+
+    ~Inserter() { reset(); }
+
+    void insert(const Key &key) { insertHash(hasher_(key)); }
+
+    void insertHash(uint64_t hash) {
+      const size_t idx = hash & (M - 1);
+      const uint64_t r = detail::hllRho<LogM>(hash);
+      auto &word = local_->words[idx >> 3];
+      const size_t shift = (idx & 7) << 3;
+      const uint64_t w = word.load(std::memory_order_relaxed);
+      if (((w >> shift) & 0xff) < r) {
+        word.store((w & ~(((uint64_t)0xff) << shift)) | (r << shift),
+                   std::memory_order_relaxed);
+      }
+    }
+
+    void insertHashes(const uint64_t *hashes, size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        insertHash(hashes[i]);
+      }
+    }
+  };
+
+  explicit ConcurrentHyperLogLog(
+      std::chrono::milliseconds mergeInterval = std::chrono::milliseconds(100))
+      : merger_([this, mergeInterval] {
+          std::unique_lock<std::mutex> lock(mu_);
+          while (!cv_.wait_for(lock, mergeInterval, [this] { return stop_; })) {
+            mergeLocked();
+          }
+        }) {}
+
+  ConcurrentHyperLogLog(const ConcurrentHyperLogLog &) = delete;
+  ConcurrentHyperLogLog &operator=(const ConcurrentHyperLogLog &) = delete;
+
+  ~ConcurrentHyperLogLog() {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    merger_.join();
+  }
+
+  /**
+   * Returns a new Inserter for the calling thread. Each one costs M bytes
+   * until it is destroyed, and the merger scans every live one, so threads
+   * should reuse theirs.
+   */
+  Inserter inserter() {
+    std::lock_guard<std::mutex> lock(mu_);
+    locals_.push_back(std::make_unique<Local>());
+    return Inserter(this, locals_.back().get());
+  }
+
+  /**
+   * The number of live Inserters.
+   */
+  size_t nInserters() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return locals_.size();
+  }
+
+  /**
+   * Inserts [begin, end) from nThreads threads, each inserting one contiguous
+   * chunk, and returns once all of them are done. Each thread's Inserter is
+   * merged and freed as the thread finishes.
+   */
+  template <class It> void parallelInsert(It begin, It end, size_t nThreads) {
+    const size_t n = std::distance(begin, end);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nThreads; ++t) {
+      It first = std::next(begin, n * t / nThreads);
+      It last = std::next(begin, n * (t + 1) / nThreads);
+      threads.emplace_back([first, last, inserter = inserter()]() mutable {
+        for (It it = first; it != last; ++it) {
+          inserter.insert(*it);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  size_t count() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    mergeLocked();
+    return HyperLogLogView<LogM>(registers_.data(), detail::kHllDense, 1.0)
+        .count();
+  }
+
+  /**
+   * Returns a copy of everything inserted so far as a HyperLogLog, e.g. to
+   * save it to disk.
+   */
+  HyperLogLog<Key, Hash, LogM> snapshot() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    mergeLocked();
+    HyperLogLog<Key, Hash, LogM> hll;
+    hll.merge(HyperLogLogView<LogM>(registers_.data(), detail::kHllDense, 1.0));
+    return hll;
+  }
+};
+} // namespace falcon
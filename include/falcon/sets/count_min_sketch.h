@@ -1,26 +1,59 @@
+#pragma once
+
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "falcon/utils/hash.h"
+#include "falcon/utils/utils.h"
 
 namespace falcon {
-template <typename Key, class Hash, size_t LogB = 11, size_t l = 8>
+/**
+ * A count-min sketch with l rows of b = 2^LogB counters of type Counter.
+ *
+ * With Conservative set, insert only raises each of the key's counters as far
+ * as the key's new estimate (the old minimum plus count) instead of adding
+ * count to all of them. Estimates are still never below the true count, but
+ * counters shared with light keys grow much more slowly, so the error is
+ * lower for the same memory. Conservative sketches cannot support deletion.
+ *
+ * Only Hash(0) is evaluated per key. Its LogB bit slices index the first
+ * rows; if l rows need more than 64 bits, further words are derived from it
+ * with mix64.
+ *
+ * Counters are stored row major in one heap allocation of l * b Counters.
+ * Narrow counters (e.g. uint16_t) fit more rows or columns in cache; they
+ * saturate at their maximum value, so a saturated estimate is only a lower
+ * bound on how far the key has gone past it.
+ */
+template <typename Key, class Hash, size_t LogB = 11, size_t l = 8,
+          bool Conservative = false, class Counter = size_t>
 class CountMinSketch {
   static_assert(4 <= LogB && LogB <= 30);
+  static_assert(std::is_unsigned_v<Counter>);
 
   static constexpr size_t b = 1 << LogB;
   static constexpr size_t numShifts = 64 / LogB;
   static constexpr size_t numHashF =
       l % numShifts ? 1 + l / numShifts : l / numShifts;
+  static constexpr Counter kMaxCount = std::numeric_limits<Counter>::max();
 
-  std::array<Hash, numHashF> hashFunctions_;
-  std::array<std::array<size_t, l>, b> arr;
+  Hash hash_;
+  std::vector<Counter> counters_;
 
-  std::array<size_t, l> hashes(const Key &key) {
+  std::array<size_t, l> hashes(uint64_t keyHash) const {
     std::array<size_t, l> hashes;
 
     size_t i = 0;
     for (size_t h = 0; h < numHashF; ++h) {
-      auto hash = hashFunctions_[h](key);
+      uint64_t hash =
+          h == 0 ? keyHash : detail::mix64(keyHash + h * 0x9e3779b97f4a7c15ull);
       size_t j = 0;
       for (; j < numShifts && i < l; ++j) {
         hashes[i++] = hash & (b - 1);
@@ -31,27 +64,203 @@ class CountMinSketch {
     return hashes;
   }
 
+  /**
+   * Returns pointers to the key's counter in every row, all computed (and
+   * prefetched) before any is read, so that the l cache misses of an insert
+   * or count overlap instead of being paid one row at a time.
+   */
+  std::array<Counter *, l> counters(uint64_t hash) {
+    auto hs = hashes(hash);
+    std::array<Counter *, l> counters;
+    for (size_t i = 0; i < l; ++i) {
+      counters[i] = &counters_[i * b + hs[i]];
+      __builtin_prefetch(counters[i], 1);
+    }
+    return counters;
+  }
+
+  // c + count, or kMaxCount if that does not fit in a Counter.
+  static Counter saturatingAdd(Counter c, size_t count) {
+    return count >= (size_t)(kMaxCount - c) ? kMaxCount : c + count;
+  }
+
 public:
-  CountMinSketch() {
-    for (size_t i = 0; i < numHashF; ++i) {
-      hashFunctions_[i] = Hash(i);
+  CountMinSketch() : hash_(0), counters_(l * b) {}
+
+  /**
+   * Returns the key's count after inserting, i.e. what count(key) would.
+   */
+  size_t insert(const Key &key, size_t count = 1) {
+    return insertHash(hash_(key), count);
+  }
+
+  /**
+   * Same as insert(key, count) for a hash that is Hash(0)(key), e.g. from
+   * hashBatch.
+   */
+  size_t insertHash(uint64_t hash, size_t count = 1) {
+    auto cs = counters(hash);
+    if constexpr (Conservative) {
+      Counter minCount = *cs[0];
+      for (size_t i = 1; i < l; ++i) {
+        minCount = std::min(minCount, *cs[i]);
+      }
+      const Counter estimate = saturatingAdd(minCount, count);
+      for (auto c : cs) {
+        *c = std::max(*c, estimate);
+      }
+      return estimate;
+    } else {
+      Counter minCount = kMaxCount;
+      for (auto c : cs) {
+        *c = saturatingAdd(*c, count);
+        minCount = std::min(minCount, *c);
+      }
+      return minCount;
+    }
+  }
+
+  /**
+   * Inserts each of the n hashes once. Every hash's counters are prefetched
+   * a few hashes ahead of updating them.
+   */
+  void insertHashes(const uint64_t *hashes, size_t n) {
+    constexpr size_t kAhead = 4;
+    for (size_t i = 0; i < std::min(n, kAhead); ++i) {
+      counters(hashes[i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (i + kAhead < n) {
+        counters(hashes[i + kAhead]);
+      }
+      insertHash(hashes[i]);
+    }
+  }
+
+  size_t count(const Key &key) { return countHash(hash_(key)); }
+
+  size_t countHash(uint64_t hash) {
+    Counter minCount = kMaxCount;
+    for (auto c : counters(hash)) {
+      minCount = std::min(minCount, *c);
+    }
+    return minCount;
+  }
+
+  /**
+   * Adds other's counters to these, so that this sketch counts both streams.
+   * Both sketches must use the same Hash seeds.
+   */
+  void merge(const CountMinSketch &other) {
+    for (size_t i = 0; i < counters_.size(); ++i) {
+      counters_[i] = saturatingAdd(counters_[i], other.counters_[i]);
+    }
+  }
+
+  /**
+   * Multiplies every counter by factor (in [0, 1]), rounding down, e.g. to
+   * age out old traffic exponentially. Afterwards estimates approximate
+   * factor times the old counts but may fall slightly below them.
+   */
+  void decay(double factor) {
+    for (auto &c : counters_) {
+      c = (Counter)(c * factor);
+    }
+  }
+
+  static constexpr size_t nCounters() { return l * b; }
+
+  /**
+   * Zeroes counters [begin, end) of the nCounters() in storage order, so
+   * that callers can spread clearing the sketch over time.
+   */
+  void reset(size_t begin, size_t end) {
+    std::fill(counters_.begin() + begin, counters_.begin() + end, 0);
+  }
+
+  void reset() { reset(0, nCounters()); }
+
+  size_t sizeInBytes() const { return counters_.size() * sizeof(Counter); }
+};
+
+/**
+ * Counts keys inserted within (roughly) the last window of time by rotating
+ * through n CountMinSketches, each of which covers window / n of it. count
+ * sums the n sketches, so it covers between window - window / n and window.
+ *
+ * An n + 1st spare sketch is zeroed kClearChunk counters per insert while it
+ * waits to become the current one, so rotating does not pause to clear a
+ * whole sketch unless inserts are too sparse to have finished the job.
+ */
+template <typename Key, class Hash, size_t LogB = 11, size_t l = 8,
+          bool Conservative = false, class Counter = size_t,
+          class Clock = std::chrono::steady_clock>
+class WindowedCountMinSketch {
+  typedef CountMinSketch<Key, Hash, LogB, l, Conservative, Counter> sketch_t;
+  static constexpr size_t kClearChunk = 64;
+
+  std::vector<sketch_t> sketches_;
+  // sketches_[cur_] takes inserts and sketches_[spare()] is being cleared.
+  size_t cur_ = 0;
+  size_t cleared_ = sketch_t::nCounters();
+  typename Clock::duration period_;
+  typename Clock::time_point periodEnd_;
+
+  size_t spare() const { return (cur_ + 1) % sketches_.size(); }
+
+  void rotate() {
+    sketches_[spare()].reset(cleared_, sketch_t::nCounters());
+    cur_ = spare();
+    cleared_ = 0;
+  }
+
+  static size_t checkPeriods(size_t n) {
+    if (UNLIKELY(n == 0)) {
+      throw std::runtime_error("A windowed sketch needs at least one period");
+    }
+    return n;
+  }
+
+public:
+  explicit WindowedCountMinSketch(typename Clock::duration window, size_t n)
+      : sketches_(checkPeriods(n) + 1), period_(window / n),
+        periodEnd_(Clock::now() + period_) {}
+
+  /**
+   * Rotates out every sub-sketch whose period ended before now. Called by
+   * insert and count; exposed so callers can drive time themselves.
+   */
+  void advance(typename Clock::time_point now) {
+    for (size_t i = 0; i < sketches_.size() && now >= periodEnd_; ++i) {
+      rotate();
+      periodEnd_ += period_;
+    }
+    if (now >= periodEnd_) {
+      // Every sketch has been rotated out; restart the periods from now.
+      periodEnd_ = now + period_;
     }
   }
 
   void insert(const Key &key, size_t count = 1) {
-    size_t i = 0;
-    for (auto h : hashes(key)) {
-      arr[i++][h] += count;
+    advance(Clock::now());
+    sketches_[cur_].insert(key, count);
+    if (cleared_ < sketch_t::nCounters()) {
+      const size_t end =
+          std::min(cleared_ + kClearChunk, sketch_t::nCounters());
+      sketches_[spare()].reset(cleared_, end);
+      cleared_ = end;
     }
   }
 
   size_t count(const Key &key) {
-    size_t minCount = std::numeric_limits<uint64_t>::max();
-    size_t i = 0;
-    for (auto h : hashes(key)) {
-      minCount = std::min(minCount, arr[i++][h]);
+    advance(Clock::now());
+    size_t total = 0;
+    for (size_t i = 0; i < sketches_.size(); ++i) {
+      if (i != spare()) {
+        total += sketches_[i].count(key);
+      }
     }
-    return minCount;
+    return total;
   }
 };
 } // namespace falcon
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "falcon/sets/bloom_filter.h"
+
+namespace falcon {
+/**
+ * A bloom filter that supports erase by keeping a 4 bit saturating counter
+ * instead of a bit per position. Counters are packed 16 to a 64 bit word, so
+ * each insert, erase, or find touches the same k words a BloomFilter with
+ * nCounters bits would.
+ *
+ * Keys are hashed once with Hash(0) and probed exactly like BloomFilter.
+ *
+ * A counter that reaches 15 sticks there: it no longer knows how many keys
+ * map to it, so decrementing it could cause false negatives. Erasing a key
+ * that was never inserted can likewise cause false negatives, so erase is a
+ * no-op for keys that find reports as absent.
+ */
+template <class Key, class Hash, size_t nCounters = detail::kDefaultNBits,
+          uint64_t k = detail::kDefaultK>
+class CountingBloomFilter {
+  static constexpr uint64_t kMax = 0xf;
+  static constexpr uint64_t kLowBits = 0x1111111111111111ull;
+
+  std::vector<uint64_t> words_;
+  Hash hash_;
+
+  uint64_t &word(size_t counterIdx) { return words_[counterIdx >> 4]; }
+  const uint64_t &word(size_t counterIdx) const {
+    return words_[counterIdx >> 4];
+  }
+  static size_t shift(size_t counterIdx) { return (counterIdx & 15) << 2; }
+
+  /**
+   * The low bit of every counter in w that is at kMax, found for all 16
+   * lanes at once. Adding or subtracting (lanes & ~saturated(w)), where lanes
+   * holds only counter low bits, steps each selected counter without a
+   * branch and leaves saturated ones alone. A counter below kMax cannot
+   * carry into its neighbour on +1, and erase only decrements counters that
+   * find saw as non-zero.
+   */
+  static uint64_t saturated(uint64_t w) {
+    return w & (w >> 1) & (w >> 2) & (w >> 3) & kLowBits;
+  }
+
+public:
+  explicit CountingBloomFilter()
+      : words_((nCounters + 15) >> 4), hash_(0) {}
+
+  void insert(const Key &key) { insertHash(hash_(key)); }
+
+  /**
+   * Same as insert(key) for a hash that is Hash(0)(key), e.g. from
+   * hashBatch.
+   */
+  void insertHash(uint64_t hash) {
+    detail::DoubleHash probe(hash);
+    for (uint64_t i = 0; i < k; ++i) {
+      size_t idx = probe(i) % nCounters;
+      auto &w = word(idx);
+      w += (((uint64_t)1) << shift(idx)) & ~saturated(w);
+    }
+  }
+
+  void insertHashes(const uint64_t *hashes, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      insertHash(hashes[i]);
+    }
+  }
+
+  /**
+   * Returns whether key was (probably) present and so removed.
+   */
+  bool erase(const Key &key) {
+    const uint64_t hash = hash_(key);
+    if (!findHash(hash)) {
+      return false;
+    }
+    detail::DoubleHash probe(hash);
+    for (uint64_t i = 0; i < k; ++i) {
+      size_t idx = probe(i) % nCounters;
+      auto &w = word(idx);
+      w -= (((uint64_t)1) << shift(idx)) & ~saturated(w);
+    }
+    return true;
+  }
+
+  bool find(const Key &key) const { return findHash(hash_(key)); }
+
+  bool findHash(uint64_t hash) const {
+    detail::DoubleHash probe(hash);
+    for (uint64_t i = 0; i < k; ++i) {
+      size_t idx = probe(i) % nCounters;
+      if (((word(idx) >> shift(idx)) & kMax) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * The fraction of non-zero counters, computed 16 counters at a time by
+   * folding each nibble onto its low bit.
+   */
+  double fillRatio() const {
+    size_t n = 0;
+    for (auto w : words_) {
+      w |= w >> 2;
+      w |= w >> 1;
+      n += __builtin_popcountll(w & kLowBits);
+    }
+    return (double)n / nCounters;
+  }
+
+  void reset() { std::fill(words_.begin(), words_.end(), 0); }
+};
+} // namespace falcon
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <tuple>
+#include <utility>
+
+#include "falcon/sets/dense_set.h"
+
+namespace falcon {
+/**
+ * An open addressing hash map built on the same probing and resizing engine
+ * as DenseSet. Entries live inline in the table, so unlike
+ * std::unordered_map there is no allocation per entry.
+ *
+ * Iteration yields std::pair<const Key, Val>&, like std::unordered_map. Any
+ * insertion may rehash the table, which invalidates all iterators and
+ * pointers into the map.
+ */
+template <class Key, class Val, class Hash = std::hash<Key>,
+          class Eq = std::equal_to<Key>, size_t probe = 1>
+class DenseMap : public detail::DenseTable<Key, std::pair<Key, Val>,
+                                           detail::MapKeyOf, Hash, Eq, probe> {
+  typedef detail::DenseTable<Key, std::pair<Key, Val>, detail::MapKeyOf, Hash,
+                             Eq, probe>
+      table_t;
+
+public:
+  typedef typename table_t::iterator iterator;
+  typedef typename table_t::const_iterator const_iterator;
+
+  /**
+   * Inserts (key, Val(args...)) if key is not in the map. Otherwise does
+   * nothing; in particular args are not consumed.
+   *
+   * Returns an iterator to the entry for key and whether it was inserted.
+   */
+  template <class Key_, class... Args>
+  std::pair<iterator, bool> try_emplace(Key_ &&key, Args &&... args) {
+    const uint64_t hash = table_t::hasher_(key);
+    size_t chain = 0;
+    auto [slot, found] = table_t::probeInsert(key, hash, chain);
+    if (!found) {
+      // Only grow when actually inserting, so lookups through operator[]
+      // never rehash.
+      if (table_t::full(0)) {
+        table_t::resize();
+        std::tie(slot, found) = table_t::probeInsert(key, hash, chain);
+      }
+      // Fill the slot before claiming it, so a throwing Val constructor
+      // leaves the map unchanged.
+      auto &val = table_t::buf_[slot].val;
+      val.second = Val(std::forward<Args>(args)...);
+      val.first = std::forward<Key_>(key);
+      table_t::claim(slot, hash, chain);
+    }
+    return {iterator(&table_t::buf_[slot],
+                     table_t::buf_.data() + table_t::buf_.size()),
+            !found};
+  }
+
+  Val &operator[](const Key &key) { return try_emplace(key).first->second; }
+
+  Val &operator[](Key &&key) {
+    return try_emplace(std::move(key)).first->second;
+  }
+
+  Val *find(const Key &key) {
+    auto elem = table_t::findElem(key, table_t::hasher_(key));
+    if (elem == nullptr) {
+      return nullptr;
+    }
+    return &elem->val.second;
+  }
+
+  const Val *find(const Key &key) const {
+    auto elem = table_t::findElem(key);
+    if (elem == nullptr) {
+      return nullptr;
+    }
+    return &elem->val.second;
+  }
+};
+} // namespace falcon
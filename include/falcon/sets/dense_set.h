@@ -1,107 +1,388 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+namespace falcon {
 namespace detail {
 enum class Tag { Empty = 0, Tombstone = 1, Value = 2 };
 
-template <class Key> struct SetElem {
+template <class Value> struct SetElem {
   mutable Tag tag = Tag::Empty;
-  Key k;
+  Value val;
   uint64_t hash;
 };
-} // namespace detail
 
-namespace falcon {
-template <class Key, size_t probe = 1> class DenseSet {
-  std::vector<detail::SetElem<Key>> buf_{1 << 10};
+/**
+ * KeyOf policies also name the type iterators expose a stored Value as,
+ * which keeps the key const so that it cannot be changed out from under its
+ * stored hash.
+ */
+struct SetKeyOf {
+  template <class Value> using Exposed = const Value;
+
+  template <class Key> const Key &operator()(const Key &k) const { return k; }
+};
+
+struct MapKeyOf {
+  // Maps store std::pair<Key, Val> so that rehash and erase can assign to
+  // it, and expose it as std::pair<const Key, Val>, whose layout is the
+  // same.
+  template <class Value>
+  using Exposed = std::pair<const typename Value::first_type,
+                            typename Value::second_type>;
+
+  template <class Key, class Val>
+  const Key &operator()(const std::pair<Key, Val> &kv) const {
+    return kv.first;
+  }
+};
+
+/**
+ * The open addressing engine shared by DenseSet and DenseMap. Every slot
+ * stores a Value, from which KeyOf extracts the key, along with the key's
+ * hash so that rehashing never calls Hash again.
+ *
+ * Slots are probed at offsets sum_{j} j^probe from the home bucket. Erasing
+ * leaves a tombstone; tombstones count towards the load and are dropped
+ * whenever the table is rehashed.
+ */
+template <class Key, class Value, class KeyOf, class Hash, class Eq,
+          size_t probe>
+class DenseTable {
+protected:
+  static constexpr size_t kMinCapacity = 1 << 10;
+  // Number of keys whose home buckets are prefetched before any of their
+  // probes are resolved by the batch APIs.
+  static constexpr size_t kBatch = 32;
+
+  std::vector<SetElem<Value>> buf_{kMinCapacity};
   size_t nElems_ = 0;
-  std::hash<Key> hasher_;
+  size_t nTombstones_ = 0;
+  Hash hasher_;
+  Eq eq_;
+  KeyOf keyOf_;
   size_t maxChain_ = 0;
 
-  const Key *insert(detail::SetElem<Key> &&setElem) {
-    // Assumes setElem is a Value
+  /**
+   * Walks k's chain. Returns the slot holding k along with true, or the slot
+   * k should be inserted into along with false, in which case chain is set
+   * to the length of k's chain up to that slot. Nothing is modified.
+   */
+  std::pair<size_t, bool> probeInsert(const Key &k, uint64_t hash,
+                                      size_t &chain) const {
     const size_t n = buf_.size();
 
-    size_t i = setElem.hash % n;
-    size_t j = 1;
-    while (true) {
-      switch (buf_[i % n].tag) {
-      case detail::Tag::Empty:
-      case detail::Tag::Tombstone:
-        buf_[i % n] = std::move(setElem);
-        maxChain_ = std::max(j, maxChain_);
-        ++nElems_;
-        return &buf_[i % n].k;
-      case detail::Tag::Value:
-        if (buf_[i % n].k == setElem.k) {
-          return &buf_[i % n].k;
+    // Walk the chain until the key is found or it can no longer be in it
+    // (an empty slot or past maxChain_), remembering the first free slot so
+    // that tombstones are reused.
+    size_t i = hash % n;
+    size_t slot = n;
+    for (size_t j = 1;; ++j) {
+      const auto &elem = buf_[i % n];
+      if (elem.tag == Tag::Value) {
+        if (elem.hash == hash && eq_(keyOf_(elem.val), k)) {
+          return {i % n, true};
+        }
+      } else {
+        if (slot == n) {
+          slot = i % n;
+          chain = j;
+        }
+        if (elem.tag == Tag::Empty) {
+          break;
         }
       }
-      i += (size_t)std::pow(j++, probe);
+      if (slot != n && j >= maxChain_) {
+        break;
+      }
+      i += (size_t)std::pow(j, probe);
     }
+    return {slot, false};
   }
 
-  void resize() {
-    const size_t n = buf_.size();
+  /**
+   * Tags the slot returned by a failed probeInsert as a Value and counts it.
+   * The caller must have filled in val already.
+   */
+  void claim(size_t slot, uint64_t hash, size_t chain) {
+    if (buf_[slot].tag == Tag::Tombstone) {
+      --nTombstones_;
+    }
+    buf_[slot].tag = Tag::Value;
+    buf_[slot].hash = hash;
+    maxChain_ = std::max(chain, maxChain_);
+    ++nElems_;
+  }
 
+  /**
+   * Returns the slot holding k, or the slot k should be inserted into along
+   * with true if k is not in the table. In the latter case the slot is
+   * already tagged as a Value and counted; the caller must fill in val.
+   */
+  std::pair<size_t, bool> findOrPrepareInsert(const Key &k, uint64_t hash) {
+    size_t chain = 0;
+    auto [slot, found] = probeInsert(k, hash, chain);
+    if (!found) {
+      claim(slot, hash, chain);
+    }
+    return {slot, !found};
+  }
+
+  /**
+   * Reinserts every value into a table of n slots. This drops all tombstones
+   * and recomputes maxChain_ from scratch.
+   */
+  void rehash(size_t n) {
     auto buf = std::move(buf_);
-    buf_ = std::vector<detail::SetElem<Key>>(n * 2);
+    buf_ = std::vector<SetElem<Value>>(n);
     nElems_ = 0;
+    nTombstones_ = 0;
     maxChain_ = 0;
 
-    for (size_t i = 0; i < n; ++i) {
-      auto setElem = std::move(buf[i]);
-      if (setElem.tag == detail::Tag::Value) {
-        insert(std::move(buf[i]));
+    for (auto &setElem : buf) {
+      if (setElem.tag == Tag::Value) {
+        auto [slot, inserted] =
+            findOrPrepareInsert(keyOf_(setElem.val), setElem.hash);
+        buf_[slot].val = std::move(setElem.val);
       }
     }
   }
 
-  const detail::SetElem<Key> *findElem(const Key &k) const {
+  // Called once values and tombstones fill 7/8 of the table. If tombstones
+  // make up most of that, compact at the same capacity instead of doubling.
+  void resize() {
+    const size_t n = buf_.size();
+    rehash(nElems_ >= ((n * 7) >> 4) ? n * 2 : n);
+  }
+
+  bool full(size_t extra) const {
+    return nElems_ + nTombstones_ + extra >= ((buf_.size() * 7) >> 3);
+  }
+
+  const SetElem<Value> *findElem(const Key &k) const {
+    return findElem(k, hasher_(k));
+  }
+
+  const SetElem<Value> *findElem(const Key &k, uint64_t hash) const {
     const size_t n = buf_.size();
 
-    auto hash = hasher_(k);
     size_t i = hash % n;
     size_t j = 1;
-    while (j <= maxChain_ && buf_[i % n].tag != detail::Tag::Empty) {
-      const auto &val = buf_[i % n];
-      if (val.tag == detail::Tag::Value && val.k == k) {
-        return &val;
+    while (j <= maxChain_ && buf_[i % n].tag != Tag::Empty) {
+      const auto &elem = buf_[i % n];
+      if (elem.tag == Tag::Value && elem.hash == hash &&
+          eq_(keyOf_(elem.val), k)) {
+        return &elem;
       }
       i += (size_t)std::pow(j++, probe);
     }
     return nullptr;
   }
 
+  SetElem<Value> *findElem(const Key &k, uint64_t hash) {
+    return const_cast<SetElem<Value> *>(
+        std::as_const(*this).findElem(k, hash));
+  }
+
+  // Rw is __builtin_prefetch's: 1 when the bucket is about to be written.
+  template <int Rw = 0> void prefetch(uint64_t hash) const {
+    __builtin_prefetch(&buf_[hash % buf_.size()], Rw);
+  }
+
 public:
-  const Key *insert(const Key &k) {
-    if (nElems_ >= ((buf_.size() * 7) >> 3)) {
-      resize();
+  /**
+   * Forward iterator over the values in the table in slot order.
+   */
+  template <bool Const> class Iterator {
+    typedef std::conditional_t<Const, const SetElem<Value>, SetElem<Value>>
+        elem_t;
+
+    elem_t *cur_ = nullptr;
+    elem_t *end_ = nullptr;
+
+    void skip() {
+      while (cur_ != end_ && cur_->tag != Tag::Value) {
+        ++cur_;
+      }
     }
-    auto hash = hasher_(k);
-    return insert({detail::Tag::Value, k, hash});
-  }
 
-  bool find(const Key &k) const {
-    auto elem = findElem(k);
-    if (elem) {
-      return true;
+    typedef typename KeyOf::template Exposed<Value> exposed_t;
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::remove_const_t<exposed_t> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::conditional_t<Const, const exposed_t, exposed_t> *pointer;
+    typedef std::conditional_t<Const, const exposed_t, exposed_t> &reference;
+
+    explicit Iterator() = default;
+    explicit Iterator(elem_t *cur, elem_t *end) : cur_(cur), end_(end) {
+      skip();
     }
-    return false;
+
+    Iterator &operator++() {
+      ++cur_;
+      skip();
+      return *this;
+    }
+
+    reference operator*() const { return *operator->(); }
+    pointer operator->() const { return reinterpret_cast<pointer>(&cur_->val); }
+
+    bool operator==(const Iterator &other) const { return cur_ == other.cur_; }
+    bool operator!=(const Iterator &other) const { return !operator==(other); }
+  };
+
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  iterator begin() {
+    return iterator(buf_.data(), buf_.data() + buf_.size());
+  }
+  iterator end() {
+    return iterator(buf_.data() + buf_.size(), buf_.data() + buf_.size());
+  }
+  const_iterator begin() const {
+    return const_iterator(buf_.data(), buf_.data() + buf_.size());
+  }
+  const_iterator end() const {
+    return const_iterator(buf_.data() + buf_.size(),
+                          buf_.data() + buf_.size());
   }
 
-  size_t erase(const Key &k) {
-    auto elem = findElem(k);
+  size_t erase(const Key &k) { return erase(k, hasher_(k)); }
+
+  /**
+   * Same as erase(k) for callers that have already computed Hash()(k).
+   */
+  size_t erase(const Key &k, uint64_t hash) {
+    auto elem = findElem(k, hash);
     if (elem) {
-      elem->tag = detail::Tag::Tombstone;
+      elem->tag = Tag::Tombstone;
+      elem->val = Value();
       --nElems_;
+      ++nTombstones_;
       return 1;
     }
     return 0;
   }
 
-  size_t size() { return nElems_; }
+  /**
+   * Rehashes into the smallest table that holds the current values at no
+   * more than half the maximum load, dropping all tombstones.
+   */
+  void shrinkToFit() {
+    size_t n = kMinCapacity;
+    while (nElems_ >= ((n * 7) >> 4)) {
+      n <<= 1;
+    }
+    rehash(n);
+  }
+
+  size_t size() const { return nElems_; }
+
+  size_t capacity() const { return buf_.size(); }
+};
+} // namespace detail
+
+template <class Key, size_t probe = 1, class Hash = std::hash<Key>,
+          class Eq = std::equal_to<Key>>
+class DenseSet
+    : public detail::DenseTable<Key, Key, detail::SetKeyOf, Hash, Eq, probe> {
+  typedef detail::DenseTable<Key, Key, detail::SetKeyOf, Hash, Eq, probe>
+      table_t;
+
+  const Key *emplace(const Key &k, uint64_t hash) {
+    auto [slot, inserted] = table_t::findOrPrepareInsert(k, hash);
+    if (inserted) {
+      table_t::buf_[slot].val = k;
+    }
+    return &table_t::buf_[slot].val;
+  }
+
+public:
+  // Keys must not be modified in place, so only const iteration is offered.
+  typedef typename table_t::const_iterator iterator;
+  typedef typename table_t::const_iterator const_iterator;
+
+  const_iterator begin() const { return table_t::begin(); }
+  const_iterator end() const { return table_t::end(); }
+
+  const Key *insert(const Key &k) { return insert(k, table_t::hasher_(k)); }
+
+  /**
+   * Same as insert(k) for callers that have already computed Hash()(k).
+   */
+  const Key *insert(const Key &k, uint64_t hash) {
+    if (table_t::full(0)) {
+      table_t::resize();
+    }
+    return emplace(k, hash);
+  }
+
+  bool find(const Key &k) const { return find(k, table_t::hasher_(k)); }
+
+  /**
+   * Same as find(k) for callers that have already computed Hash()(k).
+   */
+  bool find(const Key &k, uint64_t hash) const {
+    auto elem = table_t::findElem(k, hash);
+    if (elem) {
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * Sets out[i] to whether keys[i] is in the set for every i < n.
+   *
+   * Keys are processed kBatch at a time: the whole batch is hashed and its
+   * home buckets prefetched before any probe is resolved, so the cache misses
+   * of the batch overlap instead of being paid one after another.
+   */
+  void findBatch(const Key *keys, size_t n, bool *out) const {
+    uint64_t hashes[table_t::kBatch];
+    for (size_t b = 0; b < n; b += table_t::kBatch) {
+      const size_t m = std::min(table_t::kBatch, n - b);
+      for (size_t i = 0; i < m; ++i) {
+        hashes[i] = table_t::hasher_(keys[b + i]);
+        table_t::prefetch(hashes[i]);
+      }
+      for (size_t i = 0; i < m; ++i) {
+        out[b + i] = table_t::findElem(keys[b + i], hashes[i]) != nullptr;
+      }
+    }
+  }
+
+  /**
+   * Inserts keys[0..n). See findBatch for how the batch is processed.
+   *
+   * Returns the number of keys that were not already in the set.
+   */
+  size_t insertBatch(const Key *keys, size_t n) {
+    const size_t before = table_t::nElems_;
+    uint64_t hashes[table_t::kBatch];
+    for (size_t b = 0; b < n; b += table_t::kBatch) {
+      const size_t m = std::min(table_t::kBatch, n - b);
+      // Grow up front so that the prefetched buckets stay valid.
+      while (table_t::full(m)) {
+        table_t::resize();
+      }
+      for (size_t i = 0; i < m; ++i) {
+        hashes[i] = table_t::hasher_(keys[b + i]);
+        table_t::template prefetch<1>(hashes[i]);
+      }
+      for (size_t i = 0; i < m; ++i) {
+        emplace(keys[b + i], hashes[i]);
+      }
+    }
+    return table_t::nElems_ - before;
+  }
 };
 } // namespace falcon
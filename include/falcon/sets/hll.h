@@ -1,85 +1,647 @@
+#pragma once
+
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+#include "falcon/io/binary.h"
+#include "falcon/io/mmap.h"
+#include "falcon/utils/hash.h"
 #include "falcon/utils/utils.h"
 
 namespace falcon {
 namespace detail {
 /**
- * Computes (\sum_{i = 0}^{i = cont.size()}{2^(-cont[i])})^-1 for HyperLogLog.
+ * Ertl's sigma and tau functions from "New cardinality estimation algorithms
+ * for HyperLogLog sketches" (2017). Both are evaluated as series that are
+ * summed until they stop changing.
+ */
+inline double hllSigma(double x) {
+  if (x == 1.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double y = 1.0;
+  double z = x;
+  double zPrev;
+  do {
+    x *= x;
+    zPrev = z;
+    z += x * y;
+    y += y;
+  } while (z != zPrev);
+  return z;
+}
+
+inline double hllTau(double x) {
+  if (x == 0.0 || x == 1.0) {
+    return 0.0;
+  }
+  double y = 1.0;
+  double z = 1.0 - x;
+  double zPrev;
+  do {
+    x = std::sqrt(x);
+    zPrev = z;
+    y *= 0.5;
+    z -= (1.0 - x) * (1.0 - x) * y;
+  } while (z != zPrev);
+  return z / 3.0;
+}
+
+/**
+ * Returns hist where hist[r] is the number of registers equal to r. Registers
+ * are counted into 4 interleaved histograms so that consecutive increments
+ * of the same bucket do not serialize on each other.
+ *
+ * Each histogram covers every byte value, so registers read from a corrupt
+ * file cannot index out of bounds; values above Q + 1 count as Q + 1.
  */
-template <class Container> long double harmonicMean(const Container &cont) {
-  long double z = 0;
-  for (auto i : cont) {
-    z += std::exp2((long double)-i);
+template <size_t Q>
+std::array<uint32_t, Q + 2> registerHistogram(const uint8_t *registers,
+                                              size_t m) {
+  std::array<std::array<uint32_t, 256>, 4> hists = {};
+  size_t i = 0;
+  for (; i + 4 <= m; i += 4) {
+    ++hists[0][registers[i]];
+    ++hists[1][registers[i + 1]];
+    ++hists[2][registers[i + 2]];
+    ++hists[3][registers[i + 3]];
+  }
+  for (; i < m; ++i) {
+    ++hists[0][registers[i]];
+  }
+  std::array<uint32_t, Q + 2> hist = {};
+  for (size_t r = 0; r < 256; ++r) {
+    hist[std::min(r, Q + 1)] +=
+        hists[0][r] + hists[1][r] + hists[2][r] + hists[3][r];
   }
-  return 1.0l / z;
+  return hist;
 }
+
+/**
+ * The register value for hash: the 1-indexed position of the lowest set bit
+ * of the Q = 64 - LogM bits above the register index, or Q + 1 if they are
+ * all 0.
+ */
+template <size_t LogM> uint8_t hllRho(uint64_t hash) {
+  const uint64_t w = hash >> LogM;
+  if (UNLIKELY(w == 0)) {
+    return 64 - LogM + 1;
+  }
+  return __builtin_ctzll(w) + 1;
+}
+
+/**
+ * dst[i] = max(dst[i], src[i]) for i < n.
+ */
+inline void maxBytes(uint8_t *__restrict dst, const uint8_t *__restrict src,
+                     size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_max_epu8(a, b));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = std::max(dst[i], src[i]);
+  }
+}
+
+/**
+ * Ertl's improved estimator. It is unbiased across the whole range, from
+ * the small cardinalities where raw HyperLogLog needs linear counting to
+ * the large ones where registers saturate, without empirical bias tables.
+ * Only the histogram of register values is needed, so the cost is O(Q)
+ * floating point work on top of counting the registers.
+ */
+template <size_t Q>
+double hllEstimate(const std::array<uint32_t, Q + 2> &hist, size_t m) {
+  const double md = m;
+  double z = md * hllTau(1.0 - hist[Q + 1] / md);
+  for (size_t k = Q; k >= 1; --k) {
+    z = 0.5 * (z + hist[k]);
+  }
+  z += md * hllSigma(hist[0] / md);
+  return (0.5 / std::log(2.0)) * md * md / z;
+}
+
+/**
+ * Rounds an estimate to a count. Once every register is saturated the
+ * estimate is infinite, which saturates at the largest size_t.
+ */
+inline size_t hllRound(double estimate) {
+  if (UNLIKELY(!(estimate < 0x1p64))) {
+    return std::numeric_limits<size_t>::max();
+  }
+  return (size_t)std::round(estimate);
+}
+
+/**
+ * On disk, any number of sketches with the same LogM share one file. All
+ * integers are little endian:
+ *
+ *   header: "FHLL" | u32 version | u32 LogM | u32 0 | u64 n | u64 checksum
+ *   index:  n entries sorted by id, each
+ *           u64 id | u64 offset | u32 nSparse | u32 0 | u64 alpha | u64 sum
+ *   data:   each sketch at its offset, a multiple of 8
+ *
+ * The header checksum covers the index and each entry's sum covers its
+ * sketch, both computed with checksum64. A sketch is either its M registers
+ * as bytes (nSparse == kHllDense) or its nSparse sparse entries as u32s.
+ * alpha is the bits of a double.
+ */
+constexpr char kHllMagic[4] = {'F', 'H', 'L', 'L'};
+constexpr uint32_t kHllVersion = 1;
+constexpr size_t kHllHeaderBytes = 32;
+constexpr size_t kHllEntryBytes = 40;
+constexpr uint32_t kHllDense = ~(uint32_t)0;
 } // namespace detail
 
+template <size_t LogM> class HyperLogLogFile;
+
+/**
+ * A read only HyperLogLog whose registers live elsewhere, typically in a
+ * HyperLogLogFile's mapping, which must outlive the view. Estimating reads
+ * the registers in place without copying them.
+ *
+ * A view of corrupt registers gives a meaningless estimate but never reads
+ * outside of them.
+ */
+template <size_t LogM> class HyperLogLogView {
+  static constexpr size_t M = ((size_t)1) << LogM;
+  static constexpr size_t Q = 64 - LogM;
+
+  const uint8_t *data_ = nullptr;
+  uint32_t nSparse_ = detail::kHllDense;
+  double alpha_ = 1.0;
+
+public:
+  explicit HyperLogLogView() = default;
+  /**
+   * data holds either M registers (nSparse == detail::kHllDense) or nSparse
+   * little endian sparse entries.
+   */
+  explicit HyperLogLogView(const uint8_t *data, uint32_t nSparse, double alpha)
+      : data_(data), nSparse_(nSparse), alpha_(alpha) {}
+
+  bool isSparse() const { return nSparse_ != detail::kHllDense; }
+
+  double alpha() const { return alpha_; }
+
+  /**
+   * Calls f(idx, value) for every register, or only the non-empty ones if the
+   * sketch is sparse.
+   */
+  template <class F> void forEachRegister(F f) const {
+    if (isSparse()) {
+      for (size_t i = 0; i < nSparse_; ++i) {
+        const uint32_t e = loadLE<uint32_t>(data_ + 4 * i);
+        f((e >> 8) & (M - 1), (uint8_t)(e & 0xff));
+      }
+    } else {
+      for (size_t i = 0; i < M; ++i) {
+        f(i, data_[i]);
+      }
+    }
+  }
+
+  // Only valid if the view is dense.
+  const uint8_t *registers() const { return data_; }
+
+  size_t count() const {
+    std::array<uint32_t, Q + 2> hist = {};
+    if (isSparse()) {
+      hist[0] = M - nSparse_;
+      for (size_t i = 0; i < nSparse_; ++i) {
+        ++hist[std::min<size_t>(data_[4 * i], Q + 1)];
+      }
+    } else {
+      hist = detail::registerHistogram<Q>(data_, M);
+    }
+    return detail::hllRound(detail::hllEstimate<Q>(hist, M) * alpha_);
+  }
+};
+
+/**
+ * A HyperLogLog sketch with M = 2^LogM registers.
+ *
+ * A sketch starts out sparse: only the non-empty registers are kept, as a
+ * sorted list of (index << 8 | value) words. Once the list would take more
+ * memory than the M dense registers it is converted to them, so a sketch of
+ * a few items costs a few words rather than M bytes.
+ *
+ * Two sketches with the same LogM and Hash merge into the sketch of the union
+ * of their items.
+ */
 template <class Key, template <typename> class Hash, size_t LogM = 8>
 class HyperLogLog {
   static_assert(LogM <= 16);
   static constexpr size_t M = ((size_t)1) << LogM;
   static constexpr size_t registerMask = M - 1;
+  // Registers hold the max detail::hllRho of the hashes mapped to them, or 0
+  // while they are still empty.
+  static constexpr size_t Q = 64 - LogM;
+  static constexpr size_t kMaxSparse = M / sizeof(uint32_t);
 
   long double alpha_ = 1.0;
   Hash<Key> hasher_;
-  std::array<uint8_t, M> registers_;
+  // Exactly one of these is in use: registers_ is empty while the sketch is
+  // sparse.
+  std::vector<uint32_t> sparse_;
+  std::vector<uint8_t> registers_;
+
+  static uint32_t sparseIdx(uint32_t e) { return e >> 8; }
+  static uint8_t sparseVal(uint32_t e) { return e & 0xff; }
 
-  uint8_t countTrailingZeroes(uint64_t w) const {
-    if (UNLIKELY(w == 0)) {
-      return 64 - LogM;
+  void toDense() {
+    registers_.assign(M, 0);
+    for (auto e : sparse_) {
+      registers_[sparseIdx(e)] = sparseVal(e);
+    }
+    sparse_.clear();
+    sparse_.shrink_to_fit();
+  }
+
+  void insertSparse(size_t idx, uint8_t val) {
+    const uint32_t e = (idx << 8) | val;
+    auto it = std::lower_bound(sparse_.begin(), sparse_.end(), idx << 8);
+    if (it != sparse_.end() && sparseIdx(*it) == idx) {
+      *it = std::max(*it, e);
+      return;
+    }
+    if (sparse_.size() == kMaxSparse) {
+      toDense();
+      registers_[idx] = val;
+      return;
     }
-    return __builtin_ctzll(w);
+    sparse_.insert(it, e);
   }
 
+  void mergeSparse(const std::vector<uint32_t> &other) {
+    std::vector<uint32_t> merged;
+    merged.reserve(sparse_.size() + other.size());
+    auto a = sparse_.begin();
+    auto b = other.begin();
+    while (a != sparse_.end() && b != other.end()) {
+      if (sparseIdx(*a) == sparseIdx(*b)) {
+        merged.push_back(std::max(*a++, *b++));
+      } else {
+        merged.push_back(*a < *b ? *a++ : *b++);
+      }
+    }
+    merged.insert(merged.end(), a, sparse_.end());
+    merged.insert(merged.end(), b, other.end());
+    sparse_ = std::move(merged);
+    if (sparse_.size() > kMaxSparse) {
+      toDense();
+    }
+  }
+
+  friend class HyperLogLogFile<LogM>;
+
 public:
-  explicit HyperLogLog() { reset(); };
-  explicit HyperLogLog(long double alpha) : alpha_(alpha) { reset(); }
+  explicit HyperLogLog() = default;
+  explicit HyperLogLog(long double alpha) : alpha_(alpha) {}
+
+  /**
+   * Copies the sketch with id 0 out of a file written by saveToDisk (or
+   * HyperLogLogFile::write), after verifying its checksum.
+   */
   static HyperLogLog<Key, Hash, LogM> readFromDisk(const std::string &fname) {
-    std::ifstream infile(fname, std::ios::binary);
-    char logm;
-    infile.read(&logm, 1);
-    if (UNLIKELY(logm != LogM)) {
-      std::stringstream ss;
-      ss << "LogM from file " << logm << " does not match LogM " << LogM;
-      throw std::runtime_error(ss.str());
+    HyperLogLogFile<LogM> file(fname);
+    const size_t i = file.indexOf(0);
+    if (UNLIKELY(i == file.size())) {
+      throw std::runtime_error(fname + " has no sketch with id 0");
     }
-    long double alpha;
-    infile.read(reinterpret_cast<char *>(&alpha), sizeof(long double));
-    HyperLogLog<Key, Hash, LogM> hll(alpha);
-    infile.read(hll.registers_.data(), hll.registers_.size());
+    file.verify(i);
+    auto view = file.view(i);
+    HyperLogLog<Key, Hash, LogM> hll(view.alpha());
+    hll.merge(view);
     return hll;
   }
 
-  void insert(const Key &key) {
-    uint64_t hash = hasher_(key);
+  void insert(const Key &key) { insertHash(hasher_(key)); }
+
+  /**
+   * Same as insert(key) for a hash that is Hash<Key>()(key), e.g. from
+   * hashBatch.
+   */
+  void insertHash(uint64_t hash) {
     size_t registerIdx = hash & registerMask;
-    uint64_t w = hash >> LogM;
-    registers_[registerIdx] =
-        std::max(registers_[registerIdx], (uint8_t)countTrailingZeroes(w));
+    uint8_t r = detail::hllRho<LogM>(hash);
+    if (LIKELY(!registers_.empty())) {
+      registers_[registerIdx] = std::max(registers_[registerIdx], r);
+    } else {
+      insertSparse(registerIdx, r);
+    }
+  }
+
+  void insertHashes(const uint64_t *hashes, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      insertHash(hashes[i]);
+    }
+  }
+
+  /**
+   * Makes this the sketch of the union of both sketches' items. Dense
+   * registers are merged 16 at a time with pmaxub.
+   */
+  void merge(const HyperLogLog &other) {
+    if (registers_.empty() && other.registers_.empty()) {
+      mergeSparse(other.sparse_);
+      return;
+    }
+    if (registers_.empty()) {
+      toDense();
+    }
+    if (other.registers_.empty()) {
+      for (auto e : other.sparse_) {
+        auto &reg = registers_[sparseIdx(e)];
+        reg = std::max(reg, sparseVal(e));
+      }
+    } else {
+      detail::maxBytes(registers_.data(), other.registers_.data(), M);
+    }
   }
 
+  /**
+   * Same as merge(HyperLogLog) for a sketch that is, e.g., mapped from disk.
+   * Throws if a sparse view's entries are not sorted by strictly increasing
+   * register index, as they would be in a corrupt file.
+   */
+  void merge(const HyperLogLogView<LogM> &other) {
+    if (!other.isSparse()) {
+      if (registers_.empty()) {
+        toDense();
+      }
+      detail::maxBytes(registers_.data(), other.registers(), M);
+      return;
+    }
+    if (registers_.empty()) {
+      std::vector<uint32_t> entries;
+      other.forEachRegister([&entries](size_t idx, uint8_t val) {
+        if (UNLIKELY(!entries.empty() && sparseIdx(entries.back()) >= idx)) {
+          throw std::runtime_error("Sparse HyperLogLog entries out of order");
+        }
+        entries.push_back((idx << 8) | val);
+      });
+      mergeSparse(entries);
+      return;
+    }
+    other.forEachRegister([this](size_t idx, uint8_t val) {
+      registers_[idx] = std::max(registers_[idx], val);
+    });
+  }
+
+  /**
+   * count() is scaled by alpha, which defaults to 1. The estimator is already
+   * unbiased, so this is only useful to compensate for a poor hash.
+   */
   void setAlpha(long double alpha) { alpha_ = alpha; }
 
   size_t count() const {
-    long double z = detail::harmonicMean(registers_);
-    return z * (M << LogM) * alpha_;
+    std::array<uint32_t, Q + 2> hist = {};
+    if (registers_.empty()) {
+      hist[0] = M - sparse_.size();
+      // Values merged in from a view may be anything up to 255.
+      for (auto e : sparse_) {
+        ++hist[std::min<size_t>(sparseVal(e), Q + 1)];
+      }
+    } else {
+      hist = detail::registerHistogram<Q>(registers_.data(), M);
+    }
+    return detail::hllRound(detail::hllEstimate<Q>(hist, M) * alpha_);
   }
 
+  bool isSparse() const { return registers_.empty(); }
+
+  /**
+   * The heap memory held by the registers.
+   */
+  size_t sizeInBytes() const {
+    return sparse_.capacity() * sizeof(uint32_t) + registers_.capacity();
+  }
+
+  /**
+   * Writes a file holding just this sketch, with id 0.
+   */
   void saveToDisk(const std::string &fname) const {
+    HyperLogLogFile<LogM>::template write<Key, Hash>(fname, {{0, this}});
+  }
+
+  void reset() {
+    sparse_.clear();
+    registers_.clear();
+    registers_.shrink_to_fit();
+  }
+};
+
+/**
+ * A file of HyperLogLog sketches with the same LogM, each under a caller
+ * chosen 64 bit id (see detail::kHllMagic for the format).
+ *
+ * Opening a file maps it and validates the header and index, which costs
+ * O(number of sketches) but never touches the registers. Views read the
+ * registers straight out of the mapping; verify checks their checksums
+ * explicitly, so callers choose when to pay for reading every page.
+ */
+template <size_t LogM> class HyperLogLogFile {
+  static constexpr size_t M = ((size_t)1) << LogM;
+
+  std::string fname_;
+  MappedFile file_;
+  size_t n_ = 0;
+
+  [[noreturn]] void fail(const std::string &what) const {
+    throw std::runtime_error(fname_ + ": " + what);
+  }
+
+  const uint8_t *entry(size_t i) const {
+    return file_.data() + detail::kHllHeaderBytes + i * detail::kHllEntryBytes;
+  }
+
+  uint64_t offset(size_t i) const { return loadLE<uint64_t>(entry(i) + 8); }
+
+  uint32_t nSparse(size_t i) const { return loadLE<uint32_t>(entry(i) + 16); }
+
+  size_t nBytes(size_t i) const {
+    return nSparse(i) == detail::kHllDense ? M : 4 * (size_t)nSparse(i);
+  }
+
+  static void serialize(std::vector<uint8_t> &buf,
+                        const std::vector<uint32_t> &sparse) {
+    buf.resize(4 * sparse.size());
+    for (size_t i = 0; i < sparse.size(); ++i) {
+      storeLE(buf.data() + 4 * i, sparse[i]);
+    }
+  }
+
+public:
+  explicit HyperLogLogFile(const std::string &fname)
+      : fname_(fname), file_(fname) {
+    const uint8_t *data = file_.data();
+    const size_t size = file_.size();
+    if (size < detail::kHllHeaderBytes ||
+        !std::equal(detail::kHllMagic, detail::kHllMagic + 4, data)) {
+      fail("not a HyperLogLog file");
+    }
+    if (loadLE<uint32_t>(data + 4) != detail::kHllVersion) {
+      std::stringstream ss;
+      ss << "version " << loadLE<uint32_t>(data + 4) << " is not supported";
+      fail(ss.str());
+    }
+    if (loadLE<uint32_t>(data + 8) != LogM) {
+      std::stringstream ss;
+      ss << "LogM from file " << loadLE<uint32_t>(data + 8)
+         << " does not match LogM " << LogM;
+      fail(ss.str());
+    }
+    n_ = loadLE<uint64_t>(data + 16);
+    if (n_ > (size - detail::kHllHeaderBytes) / detail::kHllEntryBytes) {
+      fail("truncated index");
+    }
+    if (detail::checksum64(entry(0), n_ * detail::kHllEntryBytes) !=
+        loadLE<uint64_t>(data + 24)) {
+      fail("index checksum mismatch");
+    }
+    for (size_t i = 0; i < n_; ++i) {
+      if (nSparse(i) != detail::kHllDense && nSparse(i) > M) {
+        fail("corrupt index entry");
+      }
+      if (offset(i) > size || nBytes(i) > size - offset(i)) {
+        fail("truncated sketch");
+      }
+    }
+  }
+
+  size_t size() const { return n_; }
+
+  uint64_t id(size_t i) const { return loadLE<uint64_t>(entry(i)); }
+
+  /**
+   * Returns the index of the sketch with the given id, or size() if there is
+   * none. O(log size()).
+   */
+  size_t indexOf(uint64_t id) const {
+    size_t lo = 0;
+    size_t hi = n_;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (this->id(mid) < id) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo < n_ && this->id(lo) == id ? lo : n_;
+  }
+
+  HyperLogLogView<LogM> view(size_t i) const {
+    double alpha;
+    const uint64_t alphaBits = loadLE<uint64_t>(entry(i) + 24);
+    std::memcpy(&alpha, &alphaBits, sizeof(double));
+    return HyperLogLogView<LogM>(file_.data() + offset(i), nSparse(i), alpha);
+  }
+
+  /**
+   * Throws unless the registers of sketch i match their checksum.
+   */
+  void verify(size_t i) const {
+    if (detail::checksum64(file_.data() + offset(i), nBytes(i)) !=
+        loadLE<uint64_t>(entry(i) + 32)) {
+      std::stringstream ss;
+      ss << "checksum mismatch for sketch " << id(i);
+      fail(ss.str());
+    }
+  }
+
+  void verify() const {
+    for (size_t i = 0; i < n_; ++i) {
+      verify(i);
+    }
+  }
+
+  /**
+   * Writes the sketches, keyed by their ids, to fname. Ids must be unique.
+   */
+  template <class Key, template <typename> class Hash>
+  static void
+  write(const std::string &fname,
+        std::vector<std::pair<uint64_t, const HyperLogLog<Key, Hash, LogM> *>>
+            sketches) {
+    std::sort(sketches.begin(), sketches.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    const size_t n = sketches.size();
+
+    std::vector<uint8_t> index(n * detail::kHllEntryBytes);
+    std::vector<std::vector<uint8_t>> sparse(n);
+    uint64_t offset = detail::kHllHeaderBytes + index.size();
+    for (size_t i = 0; i < n; ++i) {
+      const auto &[id, hll] = sketches[i];
+      if (UNLIKELY(i > 0 && sketches[i - 1].first == id)) {
+        std::stringstream ss;
+        ss << "Duplicate sketch id " << id;
+        throw std::runtime_error(ss.str());
+      }
+      const uint8_t *data = hll->registers_.data();
+      size_t nBytes = M;
+      uint32_t nSparse = detail::kHllDense;
+      if (hll->isSparse()) {
+        serialize(sparse[i], hll->sparse_);
+        data = sparse[i].data();
+        nBytes = sparse[i].size();
+        nSparse = hll->sparse_.size();
+      }
+      const double alpha = hll->alpha_;
+      uint64_t alphaBits;
+      std::memcpy(&alphaBits, &alpha, sizeof(double));
+
+      uint8_t *e = index.data() + i * detail::kHllEntryBytes;
+      storeLE(e, id);
+      storeLE(e + 8, offset);
+      storeLE(e + 16, nSparse);
+      storeLE<uint32_t>(e + 20, 0);
+      storeLE(e + 24, alphaBits);
+      storeLE(e + 32, detail::checksum64(data, nBytes));
+      offset += (nBytes + 7) & ~(size_t)7;
+    }
+
     std::ofstream of(fname, std::ios::binary);
-    of.put(static_cast<char>(LogM));
-    of.write(reinterpret_cast<const char *>(&alpha_), sizeof(long double));
-    of.write(reinterpret_cast<const char *>(registers_.data()),
-             registers_.size());
+    of.write(detail::kHllMagic, 4);
+    writeLE(of, detail::kHllVersion);
+    writeLE<uint32_t>(of, LogM);
+    writeLE<uint32_t>(of, 0);
+    writeLE<uint64_t>(of, n);
+    writeLE(of, detail::checksum64(index.data(), index.size()));
+    of.write(reinterpret_cast<const char *>(index.data()), index.size());
+    const char padding[8] = {};
+    for (size_t i = 0; i < n; ++i) {
+      const auto *hll = sketches[i].second;
+      const uint8_t *data =
+          hll->isSparse() ? sparse[i].data() : hll->registers_.data();
+      const size_t nBytes = hll->isSparse() ? sparse[i].size() : M;
+      of.write(reinterpret_cast<const char *>(data), nBytes);
+      of.write(padding, ((nBytes + 7) & ~(size_t)7) - nBytes);
+    }
     of.flush();
+    if (UNLIKELY(!of)) {
+      throw std::runtime_error("Could not write " + fname);
+    }
   }
-
-  void reset() { std::fill(registers_.begin(), registers_.end(), 0); }
 };
 } // namespace falcon
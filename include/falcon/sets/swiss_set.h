@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "falcon/utils/hash.h"
+#include "falcon/utils/utils.h"
+
+namespace falcon {
+namespace detail {
+// Control bytes. A full slot stores the low 7 bits of its hash (0..127), so
+// the high bit alone distinguishes full slots from empty/deleted ones.
+constexpr int8_t kCtrlEmpty = -128;
+constexpr int8_t kCtrlDeleted = -2;
+constexpr size_t kGroupWidth = 16;
+
+/**
+ * A view over kGroupWidth control bytes. Every match* method returns a bitmask
+ * with bit i set iff the i-th control byte of the group matches.
+ */
+class CtrlGroup {
+#ifdef __SSE2__
+  __m128i ctrl_;
+
+public:
+  explicit CtrlGroup(const int8_t *ctrl)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl))) {}
+
+  uint32_t match(int8_t h2) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_));
+  }
+
+  uint32_t matchEmpty() const { return match(kCtrlEmpty); }
+
+  // Empty and deleted are the only control bytes with the high bit set.
+  uint32_t matchEmptyOrDeleted() const { return _mm_movemask_epi8(ctrl_); }
+#else
+  const int8_t *ctrl_;
+
+public:
+  explicit CtrlGroup(const int8_t *ctrl) : ctrl_(ctrl) {}
+
+  uint32_t match(int8_t h2) const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+      mask |= (uint32_t)(ctrl_[i] == h2) << i;
+    }
+    return mask;
+  }
+
+  uint32_t matchEmpty() const { return match(kCtrlEmpty); }
+
+  uint32_t matchEmptyOrDeleted() const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+      mask |= (uint32_t)(ctrl_[i] < 0) << i;
+    }
+    return mask;
+  }
+#endif
+};
+} // namespace detail
+
+/**
+ * An open addressing hash set in the style of Abseil's Swiss tables.
+ *
+ * Alongside the slots we keep one control byte per slot holding either
+ * Empty, Deleted, or the low 7 bits of the slot's hash. Slots are probed a
+ * group of 16 at a time: a single SSE2 compare finds every candidate in the
+ * group, so the keys themselves are only touched on a (likely) hit. Groups
+ * are visited with triangular probing, which visits every group since the
+ * number of groups is a power of two.
+ *
+ * The API mirrors DenseSet.
+ */
+template <class Key, class Hash = std::hash<Key>> class SwissSet {
+  std::vector<int8_t> ctrl_;
+  std::vector<Key> slots_;
+  size_t groupMask_ = 0;
+  size_t nElems_ = 0;
+  size_t nDeleted_ = 0;
+  Hash hasher_;
+
+  static size_t h1(uint64_t hash) { return hash >> 7; }
+  static int8_t h2(uint64_t hash) { return hash & 0x7f; }
+
+  uint64_t hash(const Key &k) const { return detail::mix64(hasher_(k)); }
+
+  size_t capacity() const { return slots_.size(); }
+
+  void init(size_t nGroups) {
+    ctrl_.assign(nGroups * detail::kGroupWidth, detail::kCtrlEmpty);
+    slots_ = std::vector<Key>(nGroups * detail::kGroupWidth);
+    groupMask_ = nGroups - 1;
+    nElems_ = 0;
+    nDeleted_ = 0;
+  }
+
+  size_t findIdx(const Key &k, uint64_t hash) const {
+    size_t g = h1(hash) & groupMask_;
+    for (size_t step = 1;; ++step) {
+      const size_t base = g * detail::kGroupWidth;
+      detail::CtrlGroup group(&ctrl_[base]);
+      for (uint32_t m = group.match(h2(hash)); m; m &= m - 1) {
+        size_t i = base + __builtin_ctz(m);
+        if (LIKELY(slots_[i] == k)) {
+          return i;
+        }
+      }
+      if (LIKELY(group.matchEmpty())) {
+        return capacity();
+      }
+      g = (g + step) & groupMask_;
+    }
+  }
+
+  // Assumes k is not in the set and that there is a free slot.
+  size_t insertIdx(Key &&k, uint64_t hash) {
+    size_t g = h1(hash) & groupMask_;
+    for (size_t step = 1;; ++step) {
+      const size_t base = g * detail::kGroupWidth;
+      uint32_t m = detail::CtrlGroup(&ctrl_[base]).matchEmptyOrDeleted();
+      if (m) {
+        size_t i = base + __builtin_ctz(m);
+        if (ctrl_[i] == detail::kCtrlDeleted) {
+          --nDeleted_;
+        }
+        ctrl_[i] = h2(hash);
+        slots_[i] = std::move(k);
+        ++nElems_;
+        return i;
+      }
+      g = (g + step) & groupMask_;
+    }
+  }
+
+  void rehash(size_t nGroups) {
+    auto ctrl = std::move(ctrl_);
+    auto slots = std::move(slots_);
+    init(nGroups);
+    for (size_t i = 0; i < ctrl.size(); ++i) {
+      if (ctrl[i] >= 0) {
+        auto hash = this->hash(slots[i]);
+        insertIdx(std::move(slots[i]), hash);
+      }
+    }
+  }
+
+  // Keeps the load (including deleted slots) at or below 7/8.
+  void reserveOne() {
+    if (nElems_ + nDeleted_ + 1 <= (capacity() * 7) >> 3) {
+      return;
+    }
+    const size_t nGroups = groupMask_ + 1;
+    // If most of the load is deleted slots, purge them at the same capacity
+    // instead of growing.
+    rehash(nElems_ + 1 <= (capacity() * 7) >> 4 ? nGroups : nGroups * 2);
+  }
+
+public:
+  explicit SwissSet() { init(1 << 6); }
+
+  const Key *insert(const Key &k) {
+    auto hash = this->hash(k);
+    size_t i = findIdx(k, hash);
+    if (i != capacity()) {
+      return &slots_[i];
+    }
+    reserveOne();
+    return &slots_[insertIdx(Key(k), hash)];
+  }
+
+  bool find(const Key &k) const { return findIdx(k, hash(k)) != capacity(); }
+
+  size_t erase(const Key &k) {
+    size_t i = findIdx(k, hash(k));
+    if (i == capacity()) {
+      return 0;
+    }
+    // A probe only ever moves past a group that has no empty slot, so if this
+    // group still has one no lookup can depend on this slot staying occupied.
+    const size_t base = i & ~(detail::kGroupWidth - 1);
+    if (detail::CtrlGroup(&ctrl_[base]).matchEmpty()) {
+      ctrl_[i] = detail::kCtrlEmpty;
+    } else {
+      ctrl_[i] = detail::kCtrlDeleted;
+      ++nDeleted_;
+    }
+    slots_[i] = Key();
+    --nElems_;
+    return 1;
+  }
+
+  size_t size() { return nElems_; }
+};
+} // namespace falcon
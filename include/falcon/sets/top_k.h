@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "falcon/sets/count_min_sketch.h"
+#include "falcon/sets/dense_map.h"
+
+namespace falcon {
+/**
+ * Tracks the (approximately) K most frequent keys of a stream.
+ *
+ * Every key is counted by a conservative update CountMinSketch. The K keys
+ * with the highest estimates are kept in a min-heap ordered by estimate,
+ * along with a DenseMap from each of them to its position in the heap. An
+ * insert whose new estimate does not beat the heap's minimum cannot be in the
+ * heap (its old estimate would be below the minimum too), so most inserts of
+ * a skewed stream cost one sketch update and one compare.
+ *
+ * Hash(0) hashes keys for the sketch, as for CountMinSketch; Hash() hashes
+ * the keys in the heap's index.
+ */
+template <class Key, class Hash, size_t K, size_t LogB = 16, size_t l = 4,
+          class Counter = uint32_t>
+class TopK {
+  static_assert(K > 0);
+
+protected:
+  struct Entry {
+    size_t count;
+    Key key;
+  };
+
+  CountMinSketch<Key, Hash, LogB, l, true, Counter> sketch_;
+  std::vector<Entry> heap_;
+  DenseMap<Key, size_t, Hash> pos_;
+
+private:
+  void swap(size_t i, size_t j) {
+    std::swap(heap_[i], heap_[j]);
+    *pos_.find(heap_[i].key) = i;
+    *pos_.find(heap_[j].key) = j;
+  }
+
+  void siftUp(size_t i) {
+    while (i > 0) {
+      const size_t parent = (i - 1) / 2;
+      if (heap_[parent].count <= heap_[i].count) {
+        return;
+      }
+      swap(i, parent);
+      i = parent;
+    }
+  }
+
+  void siftDown(size_t i) {
+    const size_t n = heap_.size();
+    for (;;) {
+      size_t min = i;
+      for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < n; ++child) {
+        if (heap_[child].count < heap_[min].count) {
+          min = child;
+        }
+      }
+      if (min == i) {
+        return;
+      }
+      swap(i, min);
+      i = min;
+    }
+  }
+
+public:
+  explicit TopK() { heap_.reserve(K); }
+
+  void insert(const Key &key, size_t count = 1) {
+    const size_t estimate = sketch_.insert(key, count);
+    if (heap_.size() == K && estimate <= heap_[0].count) {
+      return;
+    }
+
+    auto pos = pos_.find(key);
+    if (pos) {
+      heap_[*pos].count = estimate;
+      siftDown(*pos);
+    } else if (heap_.size() < K) {
+      pos_[key] = heap_.size();
+      heap_.push_back({estimate, key});
+      siftUp(heap_.size() - 1);
+    } else {
+      pos_.erase(heap_[0].key);
+      heap_[0] = {estimate, key};
+      pos_[key] = 0;
+      siftDown(0);
+    }
+  }
+
+  /**
+   * The sketch's estimate for any key, tracked or not.
+   */
+  size_t count(const Key &key) { return sketch_.count(key); }
+
+  /**
+   * Returns the tracked keys and their estimates in heap order, which starts
+   * with the least frequent; sort them if they are needed most frequent
+   * first. O(K) and independent of the length of the stream.
+   */
+  std::vector<std::pair<Key, size_t>> top() const {
+    std::vector<std::pair<Key, size_t>> top;
+    top.reserve(heap_.size());
+    for (const auto &entry : heap_) {
+      top.emplace_back(entry.key, entry.count);
+    }
+    return top;
+  }
+
+  size_t size() const { return heap_.size(); }
+};
+} // namespace falcon
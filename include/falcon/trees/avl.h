@@ -2,107 +2,152 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <memory>
 
 #include "falcon/trees/bst.h"
 
 namespace falcon {
 namespace detail {
-template <class Key, class Val>
-struct AVLNode : public BSTNode<AVLNode, Key, Val> {
-  size_t height = 1;
+template <class Key, class Val, bool OrderStats>
+struct AVLNode : public BSTNode<AVLNode, Key, Val, OrderStats> {
+  ssize_t height = 1;
 
   template <class Key_, class Val_>
   AVLNode(Key_ &&key, Val_ &&val)
-      : BSTNode<AVLNode, Key, Val>(std::forward<Key_>(key),
-                                   std::forward<Val_>(val)) {}
+      : BSTNode<AVLNode, Key, Val, OrderStats>(std::forward<Key_>(key),
+                                               std::forward<Val_>(val)) {}
 };
 } // namespace detail
 
-template <class Key, class Val>
-class AVLTree : public BST<detail::AVLNode, Key, Val> {
-  size_t height(detail::AVLNode<Key, Val> *node) {
+template <class Key, class Val, template <typename> class Alloc = NodeArena,
+          bool OrderStats = false>
+class AVLTree : public BST<detail::AVLNode, Key, Val, Alloc, OrderStats> {
+  typedef BST<detail::AVLNode, Key, Val, Alloc, OrderStats> bst_t;
+
+  static ssize_t height(typename bst_t::node_t *node) {
     if (node == nullptr) {
       return 0;
     }
     return node->height;
   }
 
-  ssize_t deltaH(detail::AVLNode<Key, Val> *node) {
-    return height(node->left.get()) - height(node->right.get());
+  static ssize_t deltaH(typename bst_t::node_t *node) {
+    return height(node->left) - height(node->right);
   }
 
-  void rebalance(detail::AVLNode<Key, Val> *node) {
-    while (1) {
-      if (node == nullptr) {
-        return;
-      }
-      auto parent = node->parent;
-      if (parent == nullptr) {
-        return;
-      }
-      parent->height =
-          std::max(height(parent->left.get()), height(parent->right.get())) + 1;
-      auto grandparent = parent->parent;
-      if (grandparent == nullptr) {
-        return;
-      }
-      grandparent->height = std::max(height(grandparent->left.get()),
-                                     height(grandparent->right.get())) +
-                            1;
-      if (parent->left.get() == node) {
-        if (grandparent->left.get() == parent) {
-          if (deltaH(grandparent) == 2) {
-            BST<detail::AVLNode, Key, Val>::rotateRight(parent);
-            grandparent->height -= 2;
-            node = parent;
-            continue;
-          }
-        } else {
-          if (deltaH(grandparent) == -2) {
-            BST<detail::AVLNode, Key, Val>::rotateRight(node);
-            ++node->height;
-            --parent->height;
-            BST<detail::AVLNode, Key, Val>::rotateLeft(node);
-            grandparent->height -= 2;
-            continue;
-          }
+  static void updateHeight(typename bst_t::node_t *node) {
+    node->height = std::max(height(node->left), height(node->right)) + 1;
+  }
+
+  /**
+   * Rotates node above its parent and fixes both of their heights.
+   */
+  void rotateUp(typename bst_t::node_t *node) {
+    auto parent = node->parent;
+    if (parent->left == node) {
+      bst_t::rotateRight(node);
+    } else {
+      bst_t::rotateLeft(node);
+    }
+    updateHeight(parent);
+    updateHeight(node);
+  }
+
+  /**
+   * Walks up from node, whose subtrees changed by an insert or erase,
+   * fixing heights and rotating wherever they differ by 2. Stops once a
+   * subtree's height is unchanged, since nothing above it can change.
+   */
+  void rebalance(typename bst_t::node_t *node) {
+    while (node) {
+      const ssize_t old = node->height;
+      updateHeight(node);
+      const ssize_t delta = deltaH(node);
+      if (delta == 2) {
+        if (deltaH(node->left) < 0) {
+          rotateUp(node->left->right);
         }
-      } else {
-        if (grandparent->right.get() == parent) {
-          if (deltaH(grandparent) == -2) {
-            BST<detail::AVLNode, Key, Val>::rotateLeft(parent);
-            grandparent->height -= 2;
-            node = parent;
-            continue;
-          }
-        } else {
-          if (deltaH(grandparent) == 2) {
-            BST<detail::AVLNode, Key, Val>::rotateLeft(node);
-            ++node->height;
-            --parent->height;
-            BST<detail::AVLNode, Key, Val>::rotateRight(node);
-            grandparent->height -= 2;
-            continue;
-          }
+        rotateUp(node->left);
+        node = node->parent;
+      } else if (delta == -2) {
+        if (deltaH(node->right) > 0) {
+          rotateUp(node->right->left);
         }
+        rotateUp(node->right);
+        node = node->parent;
       }
-      node = grandparent;
+      if (height(node) == old) {
+        return;
+      }
+      node = node->parent;
+    }
+  }
+
+  void unlink(typename bst_t::node_t *node) {
+    if (node->left && node->right) {
+      auto succ = bst_t::swapWithSuccessor(node);
+      std::swap(node->height, succ->height);
     }
+    auto parent = node->parent;
+    bst_t::splice(node);
+    rebalance(parent);
   }
 
 public:
+  typedef typename bst_t::node_handle_t node_handle_t;
+
+  /**
+   * Builds a perfectly balanced tree from [begin, end), a forward range of
+   * (key, value) pairs with strictly increasing keys, in O(n). Throws
+   * std::runtime_error if the keys are not strictly increasing.
+   */
+  template <class It> static AVLTree fromSorted(It begin, It end) {
+    AVLTree tree;
+    tree.buildSorted(begin, end,
+                     [](typename bst_t::node_t *node, size_t, size_t height) {
+                       node->height = height;
+                     });
+    return tree;
+  }
+
   void emplace(Key key, Val val) {
-    if (BST<detail::AVLNode, Key, Val>::root_ == nullptr) {
-      BST<detail::AVLNode, Key, Val>::root_ =
-          std::make_unique<detail::AVLNode<Key, Val>>(std::forward<Key>(key),
-                                                      std::forward<Val>(val));
-      ++BST<detail::AVLNode, Key, Val>::size_;
-      return;
+    auto node = bst_t::emplace(std::move(key), std::move(val));
+    if (node) {
+      rebalance(node->parent);
     }
+  }
 
-    rebalance(BST<detail::AVLNode, Key, Val>::emplace(std::move(key),
-                                                      std::move(val)));
+  /**
+   * Returns whether key was present.
+   */
+  bool erase(const Key &key) {
+    auto node = bst_t::findNode(key);
+    if (node == nullptr) {
+      return false;
+    }
+    unlink(node);
+    bst_t::freeNode(node);
+    return true;
+  }
+
+  /**
+   * Unlinks key's node and returns it, or an empty handle if key is not
+   * present. See NodeHandle.
+   */
+  node_handle_t extract(const Key &key) {
+    auto node = bst_t::findNode(key);
+    if (node == nullptr) {
+      return node_handle_t();
+    }
+    unlink(node);
+    return bst_t::makeHandle(node);
+  }
+
+  void insert(node_handle_t &&handle) {
+    auto node = bst_t::insert(std::move(handle));
+    if (node) {
+      node->height = 1;
+      rebalance(node->parent);
+    }
   }
 };
 } // namespace falcon
@@ -1,146 +1,507 @@
 #pragma once
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <utility>
 
+#include "falcon/iterators/tree.h"
+#include "falcon/trees/node_arena.h"
+#include "falcon/utils/utils.h"
+
 namespace falcon {
-template <template <typename, typename> class Node, class Key, class Val>
-struct BSTNode {
+namespace detail {
+template <bool OrderStats> struct SubtreeSize {};
+
+/**
+ * The number of nodes in the subtree rooted at this node, kept by trees
+ * with OrderStats for select and rank.
+ */
+template <> struct SubtreeSize<true> {
+  size_t size = 1;
+};
+} // namespace detail
+
+template <template <typename, typename, bool> class Node, class Key, class Val,
+          bool OrderStats>
+struct BSTNode : public detail::SubtreeSize<OrderStats> {
   typedef std::pair<Key, Val> data_t;
 
-  Node<Key, Val> *parent = nullptr;
-  std::unique_ptr<Node<Key, Val>> left = nullptr;
-  std::unique_ptr<Node<Key, Val>> right = nullptr;
+  Node<Key, Val, OrderStats> *parent = nullptr;
+  Node<Key, Val, OrderStats> *left = nullptr;
+  Node<Key, Val, OrderStats> *right = nullptr;
   std::pair<Key, Val> data;
 
   template <class Key_, class Val_>
   BSTNode(Key_ &&key, Val_ &&val)
-      : data(std::make_pair<Key, Val>(std::forward<Key_>(key),
-                                      std::forward<Val_>(val))) {}
+      : data(std::forward<Key_>(key), std::forward<Val_>(val)) {}
 
   bool isLeft() const {
-    if (parent->left.get() == this) {
+    if (parent->left == this) {
       return true;
     }
     return false;
   }
-  Node<Key, Val> *grandparent() { return parent->parent; }
-  Node<Key, Val> *uncle() {
+  Node<Key, Val, OrderStats> *grandparent() { return parent->parent; }
+  Node<Key, Val, OrderStats> *uncle() {
     auto g = grandparent();
     if (parent->isLeft()) {
-      return g->right.get();
+      return g->right;
     } else {
-      return g->left.get();
+      return g->left;
     }
   }
 };
 
-template <template <typename, typename> class Node, class Key, class Val>
+namespace detail {
+/**
+ * A tree's allocator and the number of its nodes held by NodeHandles. Trees
+ * keep it on the heap, so moving a tree does not move it out from under the
+ * handles.
+ */
+template <class Alloc> struct NodeStore {
+  Alloc alloc;
+  size_t handles = 0;
+};
+} // namespace detail
+
+/**
+ * Owns a node taken out of a tree by extract. Giving it back to the same
+ * tree with insert, possibly after changing its key, links the node in
+ * again without allocating; otherwise the handle frees the node.
+ *
+ * The node stays valid when its tree is cleared, and when the tree is moved
+ * the handle goes with it and belongs to the tree moved to. The node still
+ * lives in the tree's allocator, so a handle must not outlive its tree, and
+ * assigning to a tree ends it just like destroying it does.
+ */
+template <class Node, class Alloc> class NodeHandle {
+  typedef std::allocator_traits<Alloc> alloc_traits_t;
+
+  Node *node_ = nullptr;
+  detail::NodeStore<Alloc> *store_ = nullptr;
+
+public:
+  explicit NodeHandle() = default;
+  explicit NodeHandle(Node *node, detail::NodeStore<Alloc> *store)
+      : node_(node), store_(store) {
+    ++store_->handles;
+  }
+  NodeHandle(const NodeHandle &) = delete;
+  NodeHandle &operator=(const NodeHandle &) = delete;
+
+  NodeHandle(NodeHandle &&other)
+      : node_(std::exchange(other.node_, nullptr)),
+        store_(std::exchange(other.store_, nullptr)) {}
+
+  NodeHandle &operator=(NodeHandle &&other) {
+    reset();
+    node_ = std::exchange(other.node_, nullptr);
+    store_ = std::exchange(other.store_, nullptr);
+    return *this;
+  }
+
+  ~NodeHandle() { reset(); }
+
+  void reset() {
+    if (node_) {
+      alloc_traits_t::destroy(store_->alloc, node_);
+      alloc_traits_t::deallocate(store_->alloc, node_, 1);
+      --store_->handles;
+      node_ = nullptr;
+      store_ = nullptr;
+    }
+  }
+
+  bool empty() const { return node_ == nullptr; }
+  explicit operator bool() const { return node_ != nullptr; }
+
+  auto &key() { return node_->data.first; }
+  auto &value() { return node_->data.second; }
+
+  Alloc *allocator() const { return store_ ? &store_->alloc : nullptr; }
+
+  Node *release() {
+    if (node_) {
+      --store_->handles;
+    }
+    store_ = nullptr;
+    return std::exchange(node_, nullptr);
+  }
+};
+
+/**
+ * The binary search tree that AVLTree, RBTree, and SplayTree build on. Nodes
+ * are linked by raw pointers and allocated from Alloc<Node<Key, Val>>, by
+ * default a NodeArena, so building a tree does not call malloc per node.
+ * Destroying a tree of trivially destructible nodes in a NodeArena frees the
+ * arena's chunks without visiting the nodes; otherwise the nodes are
+ * destroyed iteratively, so even a degenerate tree cannot overflow the stack.
+ *
+ * With OrderStats every node also keeps the size of its subtree, which
+ * inserts, erases, and rotations maintain, for O(log n) select and rank.
+ */
+template <template <typename, typename, bool> class Node, class Key, class Val,
+          template <typename> class Alloc = NodeArena, bool OrderStats = false>
 class BST {
+public:
+  typedef Node<Key, Val, OrderStats> node_t;
+  typedef Key key_t;
+
 protected:
-  std::unique_ptr<Node<Key, Val>> root_ = nullptr;
+  typedef Alloc<node_t> alloc_t;
+  typedef std::allocator_traits<alloc_t> alloc_traits_t;
+  typedef detail::NodeStore<alloc_t> store_t;
+
+  node_t *root_ = nullptr;
   size_t size_ = 0;
+  std::unique_ptr<store_t> store_ = std::make_unique<store_t>();
+
+  template <class Key_, class Val_>
+  node_t *newNode(Key_ &&key, Val_ &&val) {
+    auto node = alloc_traits_t::allocate(store_->alloc, 1);
+    alloc_traits_t::construct(store_->alloc, node, std::forward<Key_>(key),
+                              std::forward<Val_>(val));
+    return node;
+  }
+
+  void freeNode(node_t *node) {
+    alloc_traits_t::destroy(store_->alloc, node);
+    alloc_traits_t::deallocate(store_->alloc, node, 1);
+  }
 
-  void rotateLeft(Node<Key, Val> *node) {
+  /**
+   * Puts node where child was under child's parent (or at the root).
+   */
+  void replaceChild(node_t *child, node_t *node) {
+    auto parent = child->parent;
+    if (parent == nullptr) {
+      root_ = node;
+    } else if (parent->left == child) {
+      parent->left = node;
+    } else {
+      parent->right = node;
+    }
+    if (node) {
+      node->parent = parent;
+    }
+  }
+
+  static size_t subtreeSize(const node_t *node) {
+    return node ? node->size : 0;
+  }
+
+  /**
+   * Adds delta to the subtree size of every ancestor of node.
+   */
+  static void addToAncestors(node_t *node, ssize_t delta) {
+    if constexpr (OrderStats) {
+      for (auto cur = node->parent; cur; cur = cur->parent) {
+        cur->size += delta;
+      }
+    }
+  }
+
+  /**
+   * The subtree under node's old parent is now under node, and only the old
+   * parent's subtree changed otherwise.
+   */
+  static void rotateSizes(node_t *node, node_t *parent) {
+    if constexpr (OrderStats) {
+      node->size = parent->size;
+      parent->size = subtreeSize(parent->left) + subtreeSize(parent->right) + 1;
+    }
+  }
+
+  void rotateLeft(node_t *node) {
     auto parent = node->parent;
-    auto nodeUnique = std::move(parent->right);
-    parent->right = std::move(node->left);
+    parent->right = node->left;
     if (parent->right) {
       parent->right->parent = parent;
     }
-    auto grandparent = parent->parent;
-    if (grandparent == nullptr) {
-      node->left = std::move(root_);
-      node->left->parent = node;
-      root_ = std::move(nodeUnique);
-      root_->parent = nullptr;
-    } else if (parent->isLeft()) {
-      node->left = std::move(grandparent->left);
-      node->left->parent = node;
-      grandparent->left = std::move(nodeUnique);
-      grandparent->left->parent = grandparent;
-    } else {
-      node->left = std::move(grandparent->right);
-      node->left->parent = node;
-      grandparent->right = std::move(nodeUnique);
-      grandparent->right->parent = grandparent;
-    }
+    replaceChild(parent, node);
+    node->left = parent;
+    parent->parent = node;
+    rotateSizes(node, parent);
   }
 
-  void rotateRight(Node<Key, Val> *node) {
+  void rotateRight(node_t *node) {
     auto parent = node->parent;
-    auto nodeUnique = std::move(parent->left);
-    parent->left = std::move(node->right);
+    parent->left = node->right;
     if (parent->left) {
       parent->left->parent = parent;
     }
-    auto grandparent = parent->parent;
-    if (grandparent == nullptr) {
-      node->right = std::move(root_);
-      node->right->parent = node;
-      root_ = std::move(nodeUnique);
-      node->parent = nullptr;
-    } else if (parent->isLeft()) {
-      node->right = std::move(grandparent->left);
-      node->right->parent = node;
-      grandparent->left = std::move(nodeUnique);
-      grandparent->left->parent = grandparent;
-    } else {
-      node->right = std::move(grandparent->right);
-      node->right->parent = node;
-      grandparent->right = std::move(nodeUnique);
-      grandparent->right->parent = grandparent;
+    replaceChild(parent, node);
+    node->right = parent;
+    parent->parent = node;
+    rotateSizes(node, parent);
+  }
+
+  /**
+   * Returns the link that points, or would point, to key's node, along with
+   * the node that owns the link (nullptr for the root).
+   */
+  std::pair<node_t **, node_t *> findLink(const Key &key) {
+    node_t **link = &root_;
+    node_t *parent = nullptr;
+    while (*link && !(key == (*link)->data.first)) {
+      parent = *link;
+      link = key < parent->data.first ? &parent->left : &parent->right;
     }
+    return {link, parent};
   }
 
+  /**
+   * Overwrites key's value if it is present and returns nullptr. Otherwise
+   * links in a new leaf and returns it, leaving rebalancing to the caller.
+   */
   template <class Key_, class Val_>
-  Node<Key, Val> *emplace(Key_ &&key, Val_ &&val) {
-    auto cur = root_.get();
-    while (true) {
-      if (key == cur->data.first) {
-        cur->data.second = std::forward<Val_>(val);
-        return nullptr;
-      } else if (key < cur->data.first) {
-        if (cur->left) {
-          cur = cur->left.get();
-        } else {
-          cur->left = std::make_unique<Node<Key, Val>>(std::forward<Key_>(key),
-                                                       std::forward<Val_>(val));
-          cur->left->parent = cur;
-          ++size_;
-          return cur->left.get();
-        }
-      } else {
-        if (cur->right) {
-          cur = cur->right.get();
-        } else {
-          cur->right = std::make_unique<Node<Key, Val>>(
-              std::forward<Key_>(key), std::forward<Val_>(val));
-          cur->right->parent = cur;
-          ++size_;
-          return cur->right.get();
-        }
+  node_t *emplace(Key_ &&key, Val_ &&val) {
+    auto [link, parent] = findLink(key);
+    if (*link) {
+      (*link)->data.second = std::forward<Val_>(val);
+      return nullptr;
+    }
+    *link = newNode(std::forward<Key_>(key), std::forward<Val_>(val));
+    (*link)->parent = parent;
+    addToAncestors(*link, 1);
+    ++size_;
+    return *link;
+  }
+
+  /**
+   * Like emplace, but links in the extracted node held by handle instead of
+   * allocating one. A handle from another tree is copied from and freed.
+   */
+  node_t *insert(NodeHandle<node_t, alloc_t> &&handle) {
+    if (handle.empty()) {
+      return nullptr;
+    }
+    if (handle.allocator() != &store_->alloc) {
+      auto node = emplace(std::move(handle.key()), std::move(handle.value()));
+      handle.reset();
+      return node;
+    }
+    auto node = handle.release();
+    auto [link, parent] = findLink(node->data.first);
+    if (*link) {
+      (*link)->data.second = std::move(node->data.second);
+      freeNode(node);
+      return nullptr;
+    }
+    node->left = nullptr;
+    node->right = nullptr;
+    node->parent = parent;
+    if constexpr (OrderStats) {
+      node->size = 1;
+    }
+    *link = node;
+    addToAncestors(node, 1);
+    ++size_;
+    return node;
+  }
+
+  /**
+   * Swaps the positions of node, which has two children, and its in order
+   * successor without moving their data, so that node has at most one
+   * child. Subclasses swap any per position state (height, color).
+   *
+   * Returns the successor.
+   */
+  node_t *swapWithSuccessor(node_t *node) {
+    auto succ = node->right;
+    while (succ->left) {
+      succ = succ->left;
+    }
+    auto left = node->left;
+    auto right = node->right;
+    auto succParent = succ->parent;
+    auto succRight = succ->right;
+
+    replaceChild(node, succ);
+    succ->left = left;
+    left->parent = succ;
+    if (succParent == node) {
+      succ->right = node;
+      node->parent = succ;
+    } else {
+      succ->right = right;
+      right->parent = succ;
+      succParent->left = node;
+      node->parent = succParent;
+    }
+    node->left = nullptr;
+    node->right = succRight;
+    if (succRight) {
+      succRight->parent = node;
+    }
+    if constexpr (OrderStats) {
+      std::swap(node->size, succ->size);
+    }
+    return succ;
+  }
+
+  /**
+   * Unlinks node, which has at most one child, putting the child in its
+   * place. node keeps its parent pointer.
+   */
+  void splice(node_t *node) {
+    addToAncestors(node, -1);
+    auto parent = node->parent;
+    replaceChild(node, node->left ? node->left : node->right);
+    node->parent = parent;
+    node->left = nullptr;
+    node->right = nullptr;
+    --size_;
+  }
+
+  /**
+   * Links nodes[lo, hi), which are in key order, into a perfectly balanced
+   * subtree under parent and returns its root. Calls f(node, depth, height)
+   * on every node once its children are linked.
+   */
+  template <class F>
+  static node_t *linkSorted(node_t **nodes, size_t lo, size_t hi,
+                            node_t *parent, size_t depth, F &f) {
+    if (lo == hi) {
+      return nullptr;
+    }
+    const size_t mid = lo + (hi - lo) / 2;
+    auto node = nodes[mid];
+    node->parent = parent;
+    node->left = linkSorted(nodes, lo, mid, node, depth + 1, f);
+    node->right = linkSorted(nodes, mid + 1, hi, node, depth + 1, f);
+    if constexpr (OrderStats) {
+      node->size = hi - lo;
+    }
+    // A subtree of m nodes split at the middle has height floor(log2(m)) + 1.
+    f(node, depth, 64 - __builtin_clzll(hi - lo));
+    return node;
+  }
+
+  /**
+   * Replaces the contents of the tree with [begin, end), a forward range of
+   * (key, value) pairs with strictly increasing keys, in O(n) and without
+   * rotations. With a NodeArena all of the nodes come from one contiguous
+   * allocation, laid out in key order.
+   */
+  template <class It, class F> void buildSorted(It begin, It end, F f) {
+    auto unsorted = std::adjacent_find(
+        begin, end, [](const auto &a, const auto &b) {
+          return !(a.first < b.first);
+        });
+    if (UNLIKELY(unsorted != end)) {
+      const size_t i = std::distance(begin, unsorted);
+      throw std::runtime_error(
+          "fromSorted needs strictly increasing keys, but the keys at " +
+          std::to_string(i) + " and " + std::to_string(i + 1) +
+          " are out of order");
+    }
+
+    clear();
+    const size_t n = std::distance(begin, end);
+    if (n == 0) {
+      return;
+    }
+    std::unique_ptr<node_t *[]> nodes(new node_t *[n]);
+    if constexpr (std::is_same_v<alloc_t, NodeArena<node_t>>) {
+      auto block = alloc_traits_t::allocate(store_->alloc, n);
+      for (size_t i = 0; i < n; ++i, ++begin) {
+        nodes[i] = block + i;
+        alloc_traits_t::construct(store_->alloc, nodes[i], begin->first,
+                                  begin->second);
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i, ++begin) {
+        nodes[i] = newNode(begin->first, begin->second);
       }
     }
+    root_ = linkSorted(nodes.get(), 0, n, nullptr, 0, f);
+    size_ = n;
+  }
+
+  NodeHandle<node_t, alloc_t> makeHandle(node_t *node) {
+    return NodeHandle<node_t, alloc_t>(node, store_.get());
   }
 
-  Node<Key, Val> *findNode(const Key &key) const {
-    auto cur = root_.get();
+  node_t *findNode(const Key &key) const {
+    auto cur = root_;
     while (cur) {
       if (key == cur->data.first) {
         return cur;
       } else if (key < cur->data.first) {
-        cur = cur->left.get();
+        cur = cur->left;
       } else {
-        cur = cur->right.get();
+        cur = cur->right;
       }
     }
     return nullptr;
   }
 
 public:
-  typedef Node<Key, Val> node_t;
-  typedef Key key_t;
+  typedef NodeHandle<node_t, alloc_t> node_handle_t;
+
+  explicit BST() = default;
+  BST(const BST &) = delete;
+  BST &operator=(const BST &) = delete;
+
+  // Outstanding NodeHandles move along with the nodes (see NodeHandle).
+  BST(BST &&other)
+      : root_(std::exchange(other.root_, nullptr)),
+        size_(std::exchange(other.size_, 0)),
+        store_(std::exchange(other.store_, std::make_unique<store_t>())) {}
+
+  BST &operator=(BST &&other) {
+    clear();
+    root_ = std::exchange(other.root_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    store_ = std::exchange(other.store_, std::make_unique<store_t>());
+    return *this;
+  }
+
+  ~BST() { clear(); }
+
+  /**
+   * Dropping a NodeArena frees every node at once, but only when no
+   * NodeHandle still holds one of its nodes; otherwise the nodes are freed
+   * one by one.
+   */
+  void clear() {
+    constexpr bool kDropArena = std::is_trivially_destructible_v<node_t> &&
+                                std::is_same_v<alloc_t, NodeArena<node_t>>;
+    if (kDropArena && store_->handles == 0) {
+      if constexpr (kDropArena) {
+        store_->alloc = alloc_t();
+      }
+    } else {
+      // Free leaves bottom up, unlinking each from its parent, so that every
+      // node is visited at most three times and no stack is needed.
+      auto cur = root_;
+      while (cur) {
+        if (cur->left) {
+          cur = cur->left;
+        } else if (cur->right) {
+          cur = cur->right;
+        } else {
+          auto parent = cur->parent;
+          if (parent) {
+            if (parent->left == cur) {
+              parent->left = nullptr;
+            } else {
+              parent->right = nullptr;
+            }
+          }
+          freeNode(cur);
+          cur = parent;
+        }
+      }
+    }
+    root_ = nullptr;
+    size_ = 0;
+  }
 
   size_t size() const { return size_; }
 
@@ -174,8 +535,109 @@ public:
    * undefined behavior.
    */
   template <template <typename> class Traversal>
-  Traversal<Node<Key, Val>> traverse() const {
-    return Traversal<Node<Key, Val>>(*root_);
+  Traversal<node_t> traverse() const {
+    return Traversal<node_t>(root_);
+  }
+
+  /**
+   * Returns an iterator to the first entry whose key is not less than key,
+   * or the end iterator. Iterating from it visits the following entries in
+   * order, so a scan of k entries costs O(log n + k).
+   */
+  InOrderIt<node_t> lower_bound(const Key &key) const {
+    node_t *best = nullptr;
+    auto cur = root_;
+    while (cur) {
+      if (cur->data.first < key) {
+        cur = cur->right;
+      } else {
+        best = cur;
+        cur = cur->left;
+      }
+    }
+    return InOrderIt<node_t>(best);
+  }
+
+  /**
+   * Returns an iterator to the first entry whose key is greater than key, or
+   * the end iterator.
+   */
+  InOrderIt<node_t> upper_bound(const Key &key) const {
+    node_t *best = nullptr;
+    auto cur = root_;
+    while (cur) {
+      if (key < cur->data.first) {
+        best = cur;
+        cur = cur->left;
+      } else {
+        cur = cur->right;
+      }
+    }
+    return InOrderIt<node_t>(best);
+  }
+
+  /**
+   * The entries with keys in [first, last), in order. Empty if last is not
+   * greater than first.
+   *
+   * For example:
+   * for (const auto& data : t.range(a, b)) {}
+   */
+  detail::IteratorRange<InOrderIt<node_t>>
+  range(const Key &first, const Key &last) const {
+    if (!(first < last)) {
+      return detail::IteratorRange<InOrderIt<node_t>>(end(), end());
+    }
+    return detail::IteratorRange<InOrderIt<node_t>>(
+        lower_bound(first), lower_bound(last));
+  }
+
+  /**
+   * Returns an iterator to the k-th (0-indexed) smallest entry, or the end
+   * iterator if k >= size(). O(log n); needs OrderStats.
+   */
+  InOrderIt<node_t> select(size_t k) const {
+    static_assert(OrderStats, "select needs a tree with OrderStats");
+    auto cur = root_;
+    while (cur) {
+      const size_t left = subtreeSize(cur->left);
+      if (k < left) {
+        cur = cur->left;
+      } else if (k == left) {
+        return InOrderIt<node_t>(cur);
+      } else {
+        k -= left + 1;
+        cur = cur->right;
+      }
+    }
+    return end();
+  }
+
+  /**
+   * Returns the number of keys less than key. O(log n); needs OrderStats.
+   */
+  size_t rank(const Key &key) const {
+    static_assert(OrderStats, "rank needs a tree with OrderStats");
+    size_t n = 0;
+    auto cur = root_;
+    while (cur) {
+      if (cur->data.first < key) {
+        n += subtreeSize(cur->left) + 1;
+        cur = cur->right;
+      } else {
+        cur = cur->left;
+      }
+    }
+    return n;
   }
+
+  InOrderIt<node_t> begin() const {
+    if (root_ == nullptr) {
+      return end();
+    }
+    return InOrderIt<node_t>(*root_);
+  }
+
+  InOrderIt<node_t> end() const { return InOrderIt<node_t>(); }
 };
 } // namespace falcon
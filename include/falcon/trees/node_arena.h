@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace falcon {
+/**
+ * An allocator that carves objects out of large contiguous chunks instead of
+ * calling malloc per object. Deallocated objects go on a free list and are
+ * reused by later single object allocations. Chunks are only returned to the
+ * system when the arena is destroyed, so freeing everything costs one free
+ * per chunk.
+ *
+ * Chunks start at kMinChunk objects and double up to kMaxChunk. allocate(n)
+ * returns n contiguous objects, taking a new chunk of at least n if the
+ * current one is too small.
+ *
+ * Only implements the part of the Allocator interface that is used through
+ * std::allocator_traits: allocate and deallocate, with construct and destroy
+ * left to the traits' defaults. It is not a full Allocator: arenas are move
+ * only, there is no converting constructor from NodeArena<U>, and an arena
+ * only compares equal to itself, never to another arena.
+ */
+template <class T> class NodeArena {
+  static constexpr size_t kMinChunk = 64;
+  static constexpr size_t kMaxChunk = 1 << 16;
+
+  union Slot {
+    Slot *next;
+    alignas(T) unsigned char bytes[sizeof(T)];
+  };
+  static_assert(sizeof(Slot) == sizeof(T));
+
+  std::vector<std::unique_ptr<Slot[]>> chunks_;
+  size_t chunkSize_ = kMinChunk;
+  Slot *cur_ = nullptr;
+  size_t left_ = 0;
+  Slot *free_ = nullptr;
+
+  void newChunk(size_t n) {
+    const size_t size = std::max(n, chunkSize_);
+    chunks_.emplace_back(new Slot[size]);
+    cur_ = chunks_.back().get();
+    left_ = size;
+    chunkSize_ = std::min(chunkSize_ * 2, kMaxChunk);
+  }
+
+public:
+  typedef T value_type;
+
+  template <class U> struct rebind { typedef NodeArena<U> other; };
+
+  explicit NodeArena() = default;
+  NodeArena(const NodeArena &) = delete;
+  NodeArena &operator=(const NodeArena &) = delete;
+
+  NodeArena(NodeArena &&other)
+      : chunks_(std::move(other.chunks_)),
+        chunkSize_(std::exchange(other.chunkSize_, kMinChunk)),
+        cur_(std::exchange(other.cur_, nullptr)),
+        left_(std::exchange(other.left_, 0)),
+        free_(std::exchange(other.free_, nullptr)) {}
+
+  NodeArena &operator=(NodeArena &&other) {
+    chunks_ = std::move(other.chunks_);
+    chunkSize_ = std::exchange(other.chunkSize_, kMinChunk);
+    cur_ = std::exchange(other.cur_, nullptr);
+    left_ = std::exchange(other.left_, 0);
+    free_ = std::exchange(other.free_, nullptr);
+    return *this;
+  }
+
+  T *allocate(size_t n) {
+    if (n == 1 && free_) {
+      Slot *slot = free_;
+      free_ = slot->next;
+      return reinterpret_cast<T *>(slot);
+    }
+    if (left_ < n) {
+      newChunk(n);
+    }
+    Slot *slot = cur_;
+    cur_ += n;
+    left_ -= n;
+    return reinterpret_cast<T *>(slot);
+  }
+
+  void deallocate(T *p, size_t n) {
+    Slot *slot = reinterpret_cast<Slot *>(p);
+    for (size_t i = 0; i < n; ++i) {
+      slot[i].next = free_;
+      free_ = &slot[i];
+    }
+  }
+
+  bool operator==(const NodeArena &other) const { return this == &other; }
+  bool operator!=(const NodeArena &other) const { return this != &other; }
+};
+} // namespace falcon
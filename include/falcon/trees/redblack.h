@@ -1,6 +1,7 @@
 #pragma once
 
-#include <memory>
+#include <iterator>
+#include <utility>
 
 #include "falcon/trees/bst.h"
 
@@ -8,80 +9,198 @@ namespace falcon {
 namespace detail {
 enum class Color { Red = 0, Black = 1 };
 
-template <class Key, class Val>
-struct RBNode : public BSTNode<RBNode, Key, Val> {
+template <class Key, class Val, bool OrderStats>
+struct RBNode : public BSTNode<RBNode, Key, Val, OrderStats> {
   Color color = Color::Red;
 
   template <class Key_, class Val_>
   RBNode(Key_ &&key, Val_ &&val)
-      : BSTNode<RBNode, Key, Val>(std::forward<Key_>(key),
-                                  std::forward<Val_>(val)) {}
+      : BSTNode<RBNode, Key, Val, OrderStats>(std::forward<Key_>(key),
+                                              std::forward<Val_>(val)) {}
 };
 } // namespace detail
 
-template <class Key, class Val>
-class RBTree : public BST<detail::RBNode, Key, Val> {
-  void rebalance(detail::RBNode<Key, Val> *node) {
+template <class Key, class Val, template <typename> class Alloc = NodeArena,
+          bool OrderStats = false>
+class RBTree : public BST<detail::RBNode, Key, Val, Alloc, OrderStats> {
+  typedef BST<detail::RBNode, Key, Val, Alloc, OrderStats> bst_t;
+
+  static detail::Color getColor(typename bst_t::node_t *node) {
     if (node == nullptr) {
-      return;
+      return detail::Color::Black;
     }
+    return node->color;
+  }
 
-    auto parent = node->parent;
-    if (parent == nullptr) {
-      node->color = detail::Color::Black;
-      return;
+  /**
+   * Rotates node above its parent.
+   */
+  void rotateUp(typename bst_t::node_t *node) {
+    if (node->isLeft()) {
+      bst_t::rotateRight(node);
+    } else {
+      bst_t::rotateLeft(node);
     }
+  }
+
+  /**
+   * Restores the red black properties after the red node was linked in.
+   */
+  void rebalance(typename bst_t::node_t *node) {
+    while (true) {
+      auto parent = node->parent;
+      if (parent == nullptr) {
+        node->color = detail::Color::Black;
+        return;
+      }
+      if (parent->color == detail::Color::Black) {
+        return;
+      }
+
+      // parent is red, so it is not the root.
+      auto grandparent = parent->parent;
+      auto uncle = node->uncle();
+      if (getColor(uncle) == detail::Color::Red) {
+        parent->color = detail::Color::Black;
+        uncle->color = detail::Color::Black;
+        grandparent->color = detail::Color::Red;
+        node = grandparent;
+        continue;
+      }
 
-    if (parent->color == detail::Color::Black) {
+      if (node->isLeft() != parent->isLeft()) {
+        rotateUp(node);
+        std::swap(node, parent);
+      }
+      rotateUp(parent);
+      parent->color = detail::Color::Black;
+      grandparent->color = detail::Color::Red;
       return;
     }
+  }
 
-    auto uncle = node->uncle();
-    auto grandparent = node->grandparent();
-    if (getColor(uncle) == detail::Color::Red) {
+  /**
+   * Restores the red black properties after a black node was spliced out
+   * from under parent, leaving node (possibly nullptr) one black short.
+   */
+  void rebalanceErase(typename bst_t::node_t *node,
+                      typename bst_t::node_t *parent) {
+    while (parent && getColor(node) == detail::Color::Black) {
+      const bool isLeft = parent->left == node;
+      auto sibling = isLeft ? parent->right : parent->left;
+      if (sibling->color == detail::Color::Red) {
+        sibling->color = detail::Color::Black;
+        parent->color = detail::Color::Red;
+        rotateUp(sibling);
+        sibling = isLeft ? parent->right : parent->left;
+      }
+
+      auto near = isLeft ? sibling->left : sibling->right;
+      auto far = isLeft ? sibling->right : sibling->left;
+      if (getColor(near) == detail::Color::Black &&
+          getColor(far) == detail::Color::Black) {
+        sibling->color = detail::Color::Red;
+        node = parent;
+        parent = node->parent;
+        continue;
+      }
+
+      if (getColor(far) == detail::Color::Black) {
+        near->color = detail::Color::Black;
+        sibling->color = detail::Color::Red;
+        rotateUp(near);
+        far = sibling;
+        sibling = near;
+      }
+      sibling->color = parent->color;
+      parent->color = detail::Color::Black;
+      far->color = detail::Color::Black;
+      rotateUp(sibling);
+      return;
+    }
+    if (node) {
       node->color = detail::Color::Black;
-      uncle->color = detail::Color::Black;
-      grandparent->color = detail::Color::Red;
-      return rebalance(grandparent);
     }
+  }
 
-    if (grandparent->left && node == grandparent->left->right.get()) {
-      BST<detail::RBNode, Key, Val>::rotateLeft(node);
-      std::swap(node, parent);
-    } else if (grandparent->right && node == grandparent->right->left.get()) {
-      BST<detail::RBNode, Key, Val>::rotateRight(node);
-      std::swap(node, parent);
+  void unlink(typename bst_t::node_t *node) {
+    if (node->left && node->right) {
+      auto succ = bst_t::swapWithSuccessor(node);
+      std::swap(node->color, succ->color);
+    }
+    auto child = node->left ? node->left : node->right;
+    auto parent = node->parent;
+    bst_t::splice(node);
+    if (node->color == detail::Color::Black) {
+      rebalanceErase(child, parent);
     }
+  }
 
-    if (node->isLeft()) {
-      BST<detail::RBNode, Key, Val>::rotateRight(parent);
-    } else {
-      BST<detail::RBNode, Key, Val>::rotateLeft(parent);
+public:
+  typedef typename bst_t::node_handle_t node_handle_t;
+
+  /**
+   * Builds a perfectly balanced tree from [begin, end), a forward range of
+   * (key, value) pairs with strictly increasing keys, in O(n). Throws
+   * std::runtime_error if the keys are not strictly increasing.
+   *
+   * Every root to leaf path ends on one of the two deepest levels, so
+   * coloring the deepest level red and everything else black gives every
+   * path the same number of black nodes.
+   */
+  template <class It> static RBTree fromSorted(It begin, It end) {
+    const size_t n = std::distance(begin, end);
+    const size_t deepest = n ? 63 - __builtin_clzll(n) : 0;
+    RBTree tree;
+    tree.buildSorted(begin, end,
+                     [deepest](typename bst_t::node_t *node, size_t depth,
+                               size_t) {
+                       node->color = depth == deepest && depth > 0
+                                         ? detail::Color::Red
+                                         : detail::Color::Black;
+                     });
+    return tree;
+  }
+
+  void emplace(Key key, Val val) {
+    auto node = bst_t::emplace(std::move(key), std::move(val));
+    if (node) {
+      rebalance(node);
     }
-    parent->color = detail::Color::Black;
-    grandparent->color = detail::Color::Red;
   }
 
-  detail::Color getColor(detail::RBNode<Key, Val> *node) {
+  /**
+   * Returns whether key was present.
+   */
+  bool erase(const Key &key) {
+    auto node = bst_t::findNode(key);
     if (node == nullptr) {
-      return detail::Color::Black;
+      return false;
     }
-    return node->color;
+    unlink(node);
+    bst_t::freeNode(node);
+    return true;
   }
 
-public:
-  void emplace(Key key, Val val) {
-    if (BST<detail::RBNode, Key, Val>::root_ == nullptr) {
-      BST<detail::RBNode, Key, Val>::root_ =
-          std::make_unique<detail::RBNode<Key, Val>>(std::forward<Key>(key),
-                                                     std::forward<Val>(val));
-      BST<detail::RBNode, Key, Val>::root_->color = detail::Color::Black;
-      ++BST<detail::RBNode, Key, Val>::size_;
-      return;
+  /**
+   * Unlinks key's node and returns it, or an empty handle if key is not
+   * present. See NodeHandle.
+   */
+  node_handle_t extract(const Key &key) {
+    auto node = bst_t::findNode(key);
+    if (node == nullptr) {
+      return node_handle_t();
     }
+    unlink(node);
+    return bst_t::makeHandle(node);
+  }
 
-    rebalance(
-        BST<detail::RBNode, Key, Val>::emplace(std::move(key), std::move(val)));
+  void insert(node_handle_t &&handle) {
+    auto node = bst_t::insert(std::move(handle));
+    if (node) {
+      node->color = detail::Color::Red;
+      rebalance(node);
+    }
   }
 };
 } // namespace falcon
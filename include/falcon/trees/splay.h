@@ -1,24 +1,26 @@
 #pragma once
 
 #include <cstdint>
-#include <memory>
 
 #include "falcon/trees/bst.h"
 
 namespace falcon {
 namespace detail {
-template <class Key, class Val>
-struct SplayNode : public BSTNode<SplayNode, Key, Val> {
+template <class Key, class Val, bool OrderStats>
+struct SplayNode : public BSTNode<SplayNode, Key, Val, OrderStats> {
   template <class Key_, class Val_>
   SplayNode(Key_ &&key, Val_ &&val)
-      : BSTNode<SplayNode, Key, Val>(std::forward<Key_>(key),
-                                     std::forward<Val_>(val)) {}
+      : BSTNode<SplayNode, Key, Val, OrderStats>(std::forward<Key_>(key),
+                                                 std::forward<Val_>(val)) {}
 };
 } // namespace detail
 
-template <class Key, class Val>
-class SplayTree : public BST<detail::SplayNode, Key, Val> {
-  void rebalance(detail::SplayNode<Key, Val> *node) {
+template <class Key, class Val, template <typename> class Alloc = NodeArena,
+          bool OrderStats = false>
+class SplayTree : public BST<detail::SplayNode, Key, Val, Alloc, OrderStats> {
+  typedef BST<detail::SplayNode, Key, Val, Alloc, OrderStats> bst_t;
+
+  void rebalance(typename bst_t::node_t *node) {
     while (1) {
       auto parent = node->parent;
       if (parent == nullptr) {
@@ -26,53 +28,112 @@ class SplayTree : public BST<detail::SplayNode, Key, Val> {
       }
       auto grandparent = parent->parent;
       if (grandparent == nullptr) {
-        if (parent->left.get() == node) {
-          BST<detail::SplayNode, Key, Val>::rotateRight(node);
+        if (parent->left == node) {
+          bst_t::rotateRight(node);
         } else {
-          BST<detail::SplayNode, Key, Val>::rotateLeft(node);
+          bst_t::rotateLeft(node);
         }
         return;
       }
 
-      if (grandparent->left.get() == parent) {
-        if (parent->left.get() == node) {
-          BST<detail::SplayNode, Key, Val>::rotateRight(parent);
-          BST<detail::SplayNode, Key, Val>::rotateRight(node);
+      if (grandparent->left == parent) {
+        if (parent->left == node) {
+          bst_t::rotateRight(parent);
+          bst_t::rotateRight(node);
         } else {
-          BST<detail::SplayNode, Key, Val>::rotateLeft(node);
-          BST<detail::SplayNode, Key, Val>::rotateRight(node);
+          bst_t::rotateLeft(node);
+          bst_t::rotateRight(node);
         }
       } else {
-        if (parent->right.get() == node) {
-          BST<detail::SplayNode, Key, Val>::rotateLeft(parent);
-          BST<detail::SplayNode, Key, Val>::rotateLeft(node);
+        if (parent->right == node) {
+          bst_t::rotateLeft(parent);
+          bst_t::rotateLeft(node);
         } else {
-          BST<detail::SplayNode, Key, Val>::rotateRight(node);
-          BST<detail::SplayNode, Key, Val>::rotateLeft(node);
+          bst_t::rotateRight(node);
+          bst_t::rotateLeft(node);
         }
       }
     }
   }
 
-public:
-  void emplace(Key key, Val val) {
-    if (BST<detail::SplayNode, Key, Val>::root_ == nullptr) {
-      BST<detail::SplayNode, Key, Val>::root_ =
-          std::make_unique<detail::SplayNode<Key, Val>>(std::forward<Key>(key),
-                                                        std::forward<Val>(val));
-      ++BST<detail::SplayNode, Key, Val>::size_;
+  /**
+   * Splays node to the root, then joins its subtrees by splaying the
+   * largest key of the left one to its root and hanging the right one off
+   * it.
+   */
+  void unlink(typename bst_t::node_t *node) {
+    rebalance(node);
+    auto left = node->left;
+    auto right = node->right;
+    node->left = nullptr;
+    node->right = nullptr;
+    --bst_t::size_;
+    if (left == nullptr) {
+      bst_t::root_ = right;
+      if (right) {
+        right->parent = nullptr;
+      }
       return;
     }
-    BST<detail::SplayNode, Key, Val>::emplace(std::move(key), std::move(val));
+
+    left->parent = nullptr;
+    bst_t::root_ = left;
+    auto max = left;
+    while (max->right) {
+      max = max->right;
+    }
+    rebalance(max);
+    max->right = right;
+    if (right) {
+      right->parent = max;
+    }
+    if constexpr (OrderStats) {
+      max->size += bst_t::subtreeSize(right);
+    }
+  }
+
+public:
+  typedef typename bst_t::node_handle_t node_handle_t;
+
+  void emplace(Key key, Val val) {
+    bst_t::emplace(std::move(key), std::move(val));
   }
 
   Val *find(const Key &key) {
-    auto node = BST<detail::SplayNode, Key, Val>::findNode(key);
+    auto node = bst_t::findNode(key);
     if (node == nullptr) {
       return nullptr;
     }
     rebalance(node);
     return &node->data.second;
   }
+
+  /**
+   * Returns whether key was present.
+   */
+  bool erase(const Key &key) {
+    auto node = bst_t::findNode(key);
+    if (node == nullptr) {
+      return false;
+    }
+    unlink(node);
+    bst_t::freeNode(node);
+    return true;
+  }
+
+  /**
+   * Unlinks key's node and returns it, or an empty handle if key is not
+   * present. See NodeHandle.
+   */
+  node_handle_t extract(const Key &key) {
+    auto node = bst_t::findNode(key);
+    if (node == nullptr) {
+      return node_handle_t();
+    }
+    unlink(node);
+    return bst_t::makeHandle(node);
+  }
+
+  void insert(node_handle_t &&handle) { bst_t::insert(std::move(handle)); }
 };
 } // namespace falcon
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace falcon {
+namespace detail {
+/**
+ * Finalizer from MurmurHash3. std::hash is the identity for integers in
+ * libstdc++, so anything that slices bits out of a hash (tags, shards, group
+ * indices) should mix it first.
+ */
+inline uint64_t mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+} // namespace detail
+
+/**
+ * out[i] = hash(keys[i]) for i < n, so that a stream of keys can be hashed
+ * once and the hashes fed to several sketches through their insertHashes.
+ */
+template <class Key, class Hash>
+void hashBatch(const Key *keys, size_t n, Hash &hash, uint64_t *out) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = hash(keys[i]);
+  }
+}
+
+/**
+ * out[i] = detail::mix64(in[i]) for i < n, e.g. to hash integer keys or to
+ * mix the output of a weak hash. The elements are independent so the loop is
+ * vectorized; the 64 bit multiplies are single instructions with AVX-512DQ
+ * and are emulated with 32 bit multiplies on AVX2.
+ */
+inline void mixBatch(const uint64_t *__restrict in, size_t n,
+                     uint64_t *__restrict out) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = detail::mix64(in[i]);
+  }
+}
+} // namespace falcon
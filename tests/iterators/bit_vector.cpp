@@ -0,0 +1,89 @@
+#include <ctime>
+#include <random>
+#include <vector>
+
+#include "falcon/iterators/bit_vector.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kSizes[] = {1, 63, 64, 65, 1000, 1 << 14};
+
+BitVector<> randomBits(size_t n, std::vector<bool> &expected) {
+  static std::mt19937 rng(time(NULL));
+  BitVector<> bv(n);
+  expected.assign(n, false);
+  for (size_t i = 0; i < n; ++i) {
+    if (rng() % 3 == 0) {
+      bv.setBit(i);
+      expected[i] = true;
+    }
+  }
+  return bv;
+}
+} // namespace
+
+TEST(BitVector, Fixed) {
+  BitVector<130> bv;
+  ASSERT_EQ(bv.size(), 130);
+  ASSERT_EQ(bv.nWords(), 3);
+  ASSERT_EQ(bv.popcount(), 0);
+  for (size_t i = 0; i < bv.size(); ++i) {
+    ASSERT_FALSE(bv[i]);
+  }
+
+  bv.setBit(0);
+  bv.setBit(64);
+  bv.setBit(129);
+  ASSERT_TRUE(bv[0] && bv[64] && bv[129]);
+  ASSERT_FALSE(bv[1] || bv[63] || bv[128]);
+  ASSERT_EQ(bv.popcount(), 3);
+
+  auto copy = bv;
+  bv.clearBit(64);
+  ASSERT_FALSE(bv[64]);
+  ASSERT_TRUE(copy[64]);
+
+  bv.reset();
+  ASSERT_EQ(bv.popcount(), 0);
+}
+
+TEST(BitVector, Test) {
+  for (auto n : kSizes) {
+    std::vector<bool> a, b;
+    auto x = randomBits(n, a);
+    auto y = randomBits(n, b);
+
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(x[i], a[i]);
+      ASSERT_EQ(x.rank(i), count);
+      if (a[i]) {
+        ASSERT_EQ(x.select(count), i);
+        ++count;
+      }
+    }
+    ASSERT_EQ(x.popcount(), count);
+    ASSERT_EQ(x.rank(n), count);
+    ASSERT_EQ(x.select(count), n);
+
+    for (size_t i = n + 1, next = n; i-- > 0;) {
+      if (i < n && a[i]) {
+        next = i;
+      }
+      ASSERT_EQ(x.findNext(i), next);
+    }
+
+    auto andXY = x, orXY = x, xorXY = x;
+    andXY &= y;
+    orXY |= y;
+    xorXY ^= y;
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(andXY[i], a[i] && b[i]);
+      ASSERT_EQ(orXY[i], a[i] || b[i]);
+      ASSERT_EQ(xorXY[i], a[i] != b[i]);
+    }
+  }
+}
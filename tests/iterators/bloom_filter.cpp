@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "falcon/sets/bloom_filter.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kNBits = 1 << 20;
+// 8 bits per key.
+constexpr size_t kKeys = kNBits / 8;
+constexpr size_t kLookups = 1 << 20;
+const std::string kFname = "/tmp/falcon_bloom_filter_test.bf";
+
+struct MixHash {
+  uint64_t seed_ = 0;
+
+  MixHash() = default;
+  MixHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return detail::mix64(key ^ detail::mix64(seed_ + 1));
+  }
+};
+
+/**
+ * Inserts the even keys below 2 * kKeys, checks that all of them are found
+ * and returns the fraction of kLookups odd keys that are found too.
+ */
+template <class Filter> double measureFpr(Filter &filter) {
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    filter.insert(2 * i);
+  }
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    EXPECT_TRUE(filter.find(2 * i));
+  }
+  size_t falsePositives = 0;
+  for (uint64_t i = 0; i < kLookups; ++i) {
+    falsePositives += filter.find(2 * i + 1);
+  }
+  return (double)falsePositives / kLookups;
+}
+
+// The false positive rate of a plain bloom filter with kKeys keys.
+double expectedFpr(uint64_t k) {
+  return std::pow(1 - std::exp(-(double)k * kKeys / kNBits), k);
+}
+
+typedef BloomFilter<uint64_t, MixHash, kNBits, 4> filter_t;
+
+// Overwrites the file's bytes at offset with those of value.
+template <class T>
+void patch(const std::string &fname, size_t offset, T value) {
+  std::fstream f(fname, std::ios::binary | std::ios::in | std::ios::out);
+  f.seekp(offset);
+  f.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+} // namespace
+
+TEST(BlockedBloomFilter, K8) {
+  BlockedBloomFilter<uint64_t, MixHash, kNBits, 8> filter;
+  ASSERT_LT(measureFpr(filter), 1.5 * expectedFpr(8));
+}
+
+TEST(BlockedBloomFilter, K6) {
+  // With fewer than 8 bits per key, the bits must still spread over the
+  // whole block or the rate roughly doubles.
+  BlockedBloomFilter<uint64_t, MixHash, kNBits, 6> filter;
+  ASSERT_LT(measureFpr(filter), 1.5 * expectedFpr(6));
+}
+
+TEST(BloomFilter, SaveAndLoad) {
+  auto filter = std::make_unique<filter_t>();
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    filter->insert(2 * i);
+  }
+  filter->saveToDisk(kFname);
+
+  auto loaded = std::make_unique<filter_t>(filter_t::readFromDisk(kFname));
+  BloomFilterView<uint64_t, MixHash, kNBits, 4> view(kFname);
+  ASSERT_EQ(loaded->fillRatio(), filter->fillRatio());
+  for (uint64_t i = 0; i < 2 * kKeys; ++i) {
+    const bool expected = filter->find(i);
+    ASSERT_EQ(loaded->find(i), expected);
+    ASSERT_EQ(view.find(i), expected);
+  }
+  std::remove(kFname.c_str());
+}
+
+TEST(BloomFilter, BadFiles) {
+  filter_t().saveToDisk(kFname);
+  patch(kFname, 0, 'X');
+  ASSERT_THROW(filter_t::readFromDisk(kFname), std::runtime_error);
+
+  filter_t().saveToDisk(kFname);
+  patch<uint32_t>(kFname, 4, detail::kBloomVersion + 1);
+  ASSERT_THROW(filter_t::readFromDisk(kFname), std::runtime_error);
+
+  // Files written with a different nBits or k.
+  BloomFilter<uint64_t, MixHash, kNBits / 2, 4>().saveToDisk(kFname);
+  ASSERT_THROW(filter_t::readFromDisk(kFname), std::runtime_error);
+  BloomFilter<uint64_t, MixHash, kNBits, 5>().saveToDisk(kFname);
+  ASSERT_THROW(filter_t::readFromDisk(kFname), std::runtime_error);
+  typedef BloomFilterView<uint64_t, MixHash, kNBits, 4> view_t;
+  ASSERT_THROW(view_t view(kFname), std::runtime_error);
+
+  filter_t().saveToDisk(kFname);
+  std::ifstream in(kFname, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+  std::ofstream(kFname, std::ios::binary)
+      .write(bytes.data(), bytes.size() - 8);
+  ASSERT_THROW(filter_t::readFromDisk(kFname), std::runtime_error);
+  ASSERT_THROW(view_t view(kFname), std::runtime_error);
+  std::remove(kFname.c_str());
+}
+
+TEST(BloomFilter, MergeAndIntersect) {
+  // a holds [0, kKeys) and b holds [kKeys / 2, 3 * kKeys / 2).
+  auto a = std::make_unique<filter_t>();
+  auto b = std::make_unique<filter_t>();
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    a->insert(i);
+    b->insert(kKeys / 2 + i);
+  }
+
+  auto both = std::make_unique<filter_t>(*a);
+  both->intersect(*b);
+  for (uint64_t i = kKeys / 2; i < kKeys; ++i) {
+    ASSERT_TRUE(both->find(i));
+  }
+  ASSERT_LE(both->fillRatio(), std::min(a->fillRatio(), b->fillRatio()));
+
+  a->merge(*b);
+  for (uint64_t i = 0; i < kKeys + kKeys / 2; ++i) {
+    ASSERT_TRUE(a->find(i));
+  }
+  ASSERT_GE(a->fillRatio(), b->fillRatio());
+}
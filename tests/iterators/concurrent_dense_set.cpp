@@ -0,0 +1,51 @@
+#include <ctime>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "falcon/sets/concurrent_dense_set.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kThreads = 8;
+constexpr size_t kPerThread = 1 << 14;
+} // namespace
+
+TEST(ConcurrentDenseSet, Test) {
+  ConcurrentDenseSet<uint64_t> set;
+
+  // Every thread inserts its own range plus the shared range [0, kPerThread),
+  // then erases the odd keys of its own range.
+  std::vector<std::thread> threads;
+  std::vector<size_t> inserted(kThreads);
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      const uint64_t base = (t + 1) * kPerThread;
+      for (uint64_t i = 0; i < kPerThread; ++i) {
+        inserted[t] += set.insert(base + i);
+        inserted[t] += set.insert(i);
+      }
+      for (uint64_t i = 1; i < kPerThread; i += 2) {
+        ASSERT_EQ(set.erase(base + i), 1);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  size_t total = 0;
+  for (auto n : inserted) {
+    total += n;
+  }
+  ASSERT_EQ(total, (kThreads + 1) * kPerThread);
+  ASSERT_EQ(set.size(), kPerThread + kThreads * kPerThread / 2);
+
+  for (uint64_t i = 0; i < (kThreads + 1) * kPerThread; ++i) {
+    bool expected = i < kPerThread || (i & 1) == 0;
+    ASSERT_EQ(set.find(i), expected);
+  }
+}
@@ -0,0 +1,122 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "falcon/sets/concurrent_hll.h"
+#include "falcon/sets/hll.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kLogM = 12;
+constexpr size_t kThreads = 8;
+constexpr size_t kKeys = 1 << 18;
+
+template <class Key> struct MixHash {
+  uint64_t operator()(const Key &key) const { return detail::mix64(key); }
+};
+} // namespace
+
+TEST(ConcurrentHyperLogLog, ParallelInsert) {
+  std::vector<uint64_t> keys(kKeys);
+  std::iota(keys.begin(), keys.end(), 0);
+  HyperLogLog<uint64_t, MixHash, kLogM> hll;
+  for (auto k : keys) {
+    hll.insert(k);
+  }
+
+  ConcurrentHyperLogLog<uint64_t, MixHash, kLogM> chll;
+  ASSERT_EQ(chll.count(), 0);
+  chll.parallelInsert(keys.begin(), keys.end(), kThreads);
+  // Registers merge by max, so the sketch is exactly the single threaded
+  // one regardless of how the keys were split.
+  ASSERT_EQ(chll.count(), hll.count());
+  ASSERT_EQ(chll.snapshot().count(), hll.count());
+}
+
+TEST(ConcurrentHyperLogLog, RetireInserters) {
+  std::vector<uint64_t> keys(kKeys);
+  std::iota(keys.begin(), keys.end(), 0);
+  HyperLogLog<uint64_t, MixHash, kLogM> hll;
+  for (auto k : keys) {
+    hll.insert(k);
+  }
+
+  // The merger never runs, so only retiring Inserters and count merge.
+  ConcurrentHyperLogLog<uint64_t, MixHash, kLogM> chll(
+      std::chrono::hours(1));
+  for (size_t i = 0; i < 10; ++i) {
+    chll.parallelInsert(keys.begin(), keys.end(), kThreads);
+    ASSERT_EQ(chll.nInserters(), 0);
+    ASSERT_EQ(chll.count(), hll.count());
+  }
+
+  // A moved from Inserter owns nothing, and assigning over an Inserter
+  // retires the one it held.
+  ConcurrentHyperLogLog<uint64_t, MixHash, kLogM> moved(
+      std::chrono::hours(1));
+  {
+    auto a = moved.inserter();
+    auto b = moved.inserter();
+    ASSERT_EQ(moved.nInserters(), 2);
+    for (size_t i = 0; i < kKeys / 2; ++i) {
+      b.insert(keys[i]);
+    }
+    b = std::move(a);
+    ASSERT_EQ(moved.nInserters(), 1);
+    auto c = std::move(b);
+    ASSERT_EQ(moved.nInserters(), 1);
+    for (size_t i = kKeys / 2; i < kKeys; ++i) {
+      c.insert(keys[i]);
+    }
+  }
+  ASSERT_EQ(moved.nInserters(), 0);
+  ASSERT_EQ(moved.count(), hll.count());
+}
+
+TEST(ConcurrentHyperLogLog, Test) {
+  // Every thread inserts its own range plus the shared range [0, kKeys),
+  // while other threads keep calling count and the merger runs often.
+  HyperLogLog<uint64_t, MixHash, kLogM> hll;
+  for (uint64_t k = 0; k < (kThreads + 1) * kKeys; ++k) {
+    hll.insert(k);
+  }
+
+  ConcurrentHyperLogLog<uint64_t, MixHash, kLogM> chll(
+      std::chrono::milliseconds(1));
+  std::atomic<bool> done = false;
+  std::vector<std::thread> counters;
+  for (size_t t = 0; t < 2; ++t) {
+    counters.emplace_back([&]() {
+      while (!done) {
+        ASSERT_LE(chll.count(), 2 * hll.count());
+      }
+    });
+  }
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      auto inserter = chll.inserter();
+      const uint64_t base = (t + 1) * kKeys;
+      for (uint64_t i = 0; i < kKeys; ++i) {
+        inserter.insert(base + i);
+        inserter.insert(i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  done = true;
+  for (auto &thread : counters) {
+    thread.join();
+  }
+
+  ASSERT_EQ(chll.count(), hll.count());
+}
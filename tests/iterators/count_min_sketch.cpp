@@ -0,0 +1,182 @@
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "falcon/sets/count_min_sketch.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+using namespace std::chrono_literals;
+
+namespace {
+constexpr size_t kKeys = 100;
+
+struct MixHash {
+  uint64_t seed_ = 0;
+
+  MixHash() = default;
+  MixHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return detail::mix64(key ^ detail::mix64(seed_ + 1));
+  }
+};
+
+// A clock that only moves when told to.
+struct FakeClock {
+  typedef std::chrono::nanoseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<FakeClock> time_point;
+  static constexpr bool is_steady = true;
+
+  static inline time_point now_;
+
+  static time_point now() { return now_; }
+};
+
+// Inserts past the maximum of Sketch's counters, in steps and at once.
+template <class Sketch, class Counter> void testSaturation() {
+  constexpr size_t kMax = std::numeric_limits<Counter>::max();
+  Sketch sketch;
+  for (size_t i = 0; i < 3; ++i) {
+    const size_t estimate = sketch.insert(1, kMax / 2);
+    ASSERT_EQ(estimate, std::min(kMax, (i + 1) * (kMax / 2)));
+  }
+  ASSERT_EQ(sketch.insert(1, kMax), kMax);
+  ASSERT_EQ(sketch.insert(1), kMax);
+  ASSERT_EQ(sketch.count(1), kMax);
+
+  ASSERT_EQ(sketch.insert(2, 10 * kMax), kMax);
+  ASSERT_EQ(sketch.count(2), kMax);
+  ASSERT_EQ(sketch.count(3), 0);
+}
+
+typedef CountMinSketch<uint64_t, MixHash> sketch_t;
+typedef WindowedCountMinSketch<uint64_t, MixHash, 11, 8, false, size_t,
+                               FakeClock>
+    windowed_t;
+} // namespace
+
+TEST(CountMinSketch, MergeAndDecay) {
+  // With kKeys keys in 8 rows of 2048 counters, every key has a counter to
+  // itself in some row, so the estimates are exact.
+  sketch_t a;
+  sketch_t b;
+  for (uint64_t k = 0; k < kKeys; ++k) {
+    a.insert(k, k);
+    b.insert(k, 2 * k + 1);
+  }
+  a.merge(b);
+  for (uint64_t k = 0; k < kKeys; ++k) {
+    ASSERT_EQ(a.count(k), 3 * k + 1);
+  }
+
+  a.decay(0.5);
+  for (uint64_t k = 0; k < kKeys; ++k) {
+    ASSERT_EQ(a.count(k), (3 * k + 1) / 2);
+  }
+  a.decay(0);
+  for (uint64_t k = 0; k < kKeys; ++k) {
+    ASSERT_EQ(a.count(k), 0);
+  }
+
+  // Merging saturates rather than wrapping.
+  CountMinSketch<uint64_t, MixHash, 11, 8, false, uint8_t> c;
+  c.insert(1, 200);
+  c.merge(c);
+  ASSERT_EQ(c.count(1), 255);
+}
+
+TEST(CountMinSketch, Saturation) {
+  testSaturation<CountMinSketch<uint64_t, MixHash, 11, 8, false, uint8_t>,
+                 uint8_t>();
+  testSaturation<CountMinSketch<uint64_t, MixHash, 11, 8, true, uint8_t>,
+                 uint8_t>();
+  testSaturation<CountMinSketch<uint64_t, MixHash, 11, 8, false, uint16_t>,
+                 uint16_t>();
+  testSaturation<CountMinSketch<uint64_t, MixHash, 11, 8, true, uint16_t>,
+                 uint16_t>();
+}
+
+TEST(CountMinSketch, Conservative) {
+  // 16 counters per row for 1000 keys, so every counter is shared by many
+  // keys and the estimates are far from exact.
+  CountMinSketch<uint64_t, MixHash, 4, 4> standard;
+  CountMinSketch<uint64_t, MixHash, 4, 4, true> conservative;
+  std::vector<size_t> counts(10 * kKeys);
+  // Interleave the keys so that light and heavy keys update the same
+  // counters in every order.
+  for (size_t round = 0; round < 10; ++round) {
+    for (uint64_t k = 0; k < counts.size(); ++k) {
+      const size_t count = k % 7 == 0 ? k : round % 3;
+      counts[k] += count;
+      const size_t standardEstimate = standard.insert(k, count);
+      ASSERT_EQ(standardEstimate, standard.count(k));
+      const size_t conservativeEstimate = conservative.insert(k, count);
+      ASSERT_EQ(conservativeEstimate, conservative.count(k));
+    }
+  }
+  size_t standardError = 0;
+  size_t conservativeError = 0;
+  for (uint64_t k = 0; k < counts.size(); ++k) {
+    ASSERT_GE(conservative.count(k), counts[k]);
+    ASSERT_LE(conservative.count(k), standard.count(k));
+    standardError += standard.count(k) - counts[k];
+    conservativeError += conservative.count(k) - counts[k];
+  }
+  ASSERT_LT(conservativeError, standardError);
+}
+
+TEST(WindowedCountMinSketch, Expiry) {
+  // Five periods of 2s.
+  windowed_t sketch(10s, 5);
+  const auto start = FakeClock::now_;
+  for (size_t i = 0; i < 10; ++i) {
+    FakeClock::now_ = start + i * 2s + 1s;
+    sketch.insert(1);
+    sketch.insert(2, i);
+    // The sketch covers the current period and the 4 before it.
+    ASSERT_EQ(sketch.count(1), std::min<size_t>(i + 1, 5));
+    const size_t first = i < 5 ? 0 : i - 4;
+    ASSERT_EQ(sketch.count(2), (first + i) * (i - first + 1) / 2);
+  }
+
+  // The last inserts, in [18s, 20s), are dropped once the period starting
+  // at 28s begins.
+  FakeClock::now_ = start + 28s - 1ns;
+  ASSERT_EQ(sketch.count(1), 1);
+  ASSERT_EQ(sketch.count(2), 9);
+  FakeClock::now_ = start + 28s;
+  ASSERT_EQ(sketch.count(1), 0);
+  ASSERT_EQ(sketch.count(2), 0);
+}
+
+TEST(WindowedCountMinSketch, Gap) {
+  windowed_t sketch(10s, 5);
+  for (uint64_t k = 0; k < kKeys; ++k) {
+    sketch.insert(k, 3);
+    FakeClock::now_ += 100ms;
+  }
+
+  // Nothing for more than n periods: every sub-sketch is rotated out, then
+  // the periods restart from the next insert.
+  FakeClock::now_ += 1h;
+  const auto restart = FakeClock::now_;
+  for (uint64_t k = 0; k < kKeys; ++k) {
+    ASSERT_EQ(sketch.count(k), 0);
+  }
+  sketch.insert(kKeys);
+  FakeClock::now_ = restart + 10s - 1ns;
+  ASSERT_EQ(sketch.count(kKeys), 1);
+  FakeClock::now_ = restart + 10s;
+  ASSERT_EQ(sketch.count(kKeys), 0);
+}
+
+TEST(WindowedCountMinSketch, NoPeriods) {
+  ASSERT_THROW(windowed_t(10s, 0), std::runtime_error);
+}
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <cstdint>
+
+#include "falcon/sets/counting_bloom_filter.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kNCounters = 1 << 20;
+constexpr size_t kKeys = 1 << 14;
+
+struct MixHash {
+  uint64_t seed_ = 0;
+
+  MixHash() = default;
+  MixHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return detail::mix64(key ^ detail::mix64(seed_ + 1));
+  }
+};
+
+typedef CountingBloomFilter<uint64_t, MixHash, kNCounters, 4> filter_t;
+} // namespace
+
+TEST(CountingBloomFilter, InsertErase) {
+  filter_t filter;
+  ASSERT_EQ(filter.fillRatio(), 0);
+  ASSERT_FALSE(filter.erase(1));
+
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    filter.insert(2 * i);
+  }
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    ASSERT_TRUE(filter.find(2 * i));
+  }
+  // At 1/64 of a key per counter, collisions are rare and no counter comes
+  // near saturating.
+  const double expected = 1 - std::exp(-4.0 * kKeys / kNCounters);
+  ASSERT_NEAR(filter.fillRatio(), expected, expected / 10);
+
+  for (uint64_t i = 0; i < kKeys; i += 2) {
+    ASSERT_TRUE(filter.erase(2 * i));
+  }
+  for (uint64_t i = 1; i < kKeys; i += 2) {
+    ASSERT_TRUE(filter.find(2 * i));
+  }
+  for (uint64_t i = 1; i < kKeys; i += 2) {
+    ASSERT_TRUE(filter.erase(2 * i));
+  }
+  // Every counter is back at zero.
+  ASSERT_EQ(filter.fillRatio(), 0);
+  for (uint64_t i = 0; i < kKeys; ++i) {
+    ASSERT_FALSE(filter.find(2 * i));
+  }
+
+  filter.insert(1);
+  filter.reset();
+  ASSERT_FALSE(filter.find(1));
+}
+
+TEST(CountingBloomFilter, Saturation) {
+  filter_t filter;
+  filter.insert(1);
+  const double fillRatio = filter.fillRatio();
+
+  // Counters stick at 15 without carrying into their neighbours.
+  for (size_t i = 1; i < 20; ++i) {
+    filter.insert(1);
+  }
+  ASSERT_EQ(filter.fillRatio(), fillRatio);
+
+  // Saturated counters are never decremented, so the key stays present.
+  for (size_t i = 0; i < 40; ++i) {
+    ASSERT_TRUE(filter.erase(1));
+  }
+  ASSERT_TRUE(filter.find(1));
+  ASSERT_EQ(filter.fillRatio(), fillRatio);
+
+  // Below saturation every insert is undone by an erase.
+  filter.insert(2);
+  filter.insert(2);
+  ASSERT_TRUE(filter.erase(2));
+  ASSERT_TRUE(filter.find(2));
+  ASSERT_TRUE(filter.erase(2));
+  ASSERT_FALSE(filter.find(2));
+}
+
+TEST(CountingBloomFilter, NeighbourLanes) {
+  // With 16 counters every probe lands in the same word, so saturating
+  // some counters must leave the others counting exactly.
+  CountingBloomFilter<uint64_t, MixHash, 16, 4> filter;
+  for (size_t i = 0; i < 20; ++i) {
+    filter.insert(1);
+  }
+  const double fillRatio = filter.fillRatio();
+  for (uint64_t key = 2; key < 200; ++key) {
+    filter.insert(key);
+    ASSERT_TRUE(filter.find(1));
+    ASSERT_TRUE(filter.erase(key));
+    ASSERT_EQ(filter.fillRatio(), fillRatio);
+  }
+}
@@ -0,0 +1,91 @@
+#include <cstdint>
+#include <vector>
+
+#include "falcon/sets/cuckoo_filter.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kCapacity = 1 << 14;
+
+struct MixHash {
+  uint64_t seed_ = 0;
+
+  MixHash() = default;
+  MixHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return detail::mix64(key ^ detail::mix64(seed_ + 1));
+  }
+};
+
+typedef CuckooFilter<uint64_t, MixHash, uint16_t> filter_t;
+
+/**
+ * Inserts the even keys until an insert fails and returns those that went
+ * in. The key whose insert failed is not among them.
+ */
+std::vector<uint64_t> fill(filter_t &filter) {
+  std::vector<uint64_t> keys;
+  for (uint64_t k = 0; filter.insert(k); k += 2) {
+    keys.push_back(k);
+  }
+  return keys;
+}
+} // namespace
+
+TEST(CuckooFilter, InsertFindErase) {
+  filter_t filter(kCapacity);
+  ASSERT_GE(filter.capacity(), kCapacity);
+  ASSERT_FALSE(filter.erase(1));
+
+  for (uint64_t k = 0; k < kCapacity; k += 2) {
+    ASSERT_TRUE(filter.insert(k));
+  }
+  for (uint64_t k = 0; k < kCapacity; k += 2) {
+    ASSERT_TRUE(filter.find(k));
+  }
+
+  // An absent key that find rejects has no fingerprint to remove.
+  for (uint64_t k = 1; k < kCapacity; k += 2) {
+    if (!filter.find(k)) {
+      ASSERT_FALSE(filter.erase(k));
+    }
+  }
+  ASSERT_EQ(filter.size(), kCapacity / 2);
+
+  for (uint64_t k = 0; k < kCapacity; k += 4) {
+    ASSERT_TRUE(filter.erase(k));
+  }
+  ASSERT_EQ(filter.size(), kCapacity / 4);
+  for (uint64_t k = 2; k < kCapacity; k += 4) {
+    ASSERT_TRUE(filter.find(k));
+  }
+}
+
+TEST(CuckooFilter, Full) {
+  filter_t filter(kCapacity);
+  auto keys = fill(filter);
+
+  // Relocation only gives up near the 95% load the filter is sized for.
+  ASSERT_GT(keys.size(), filter.capacity() * 9 / 10);
+  ASSERT_EQ(filter.size(), keys.size());
+  // The last successful insert left a victim, which is still found.
+  for (auto k : keys) {
+    ASSERT_TRUE(filter.find(k));
+  }
+  ASSERT_FALSE(filter.insert(1));
+
+  // Erasing makes room for the victim, after which inserts work again.
+  for (size_t i = 0; i < 16; ++i) {
+    ASSERT_TRUE(filter.erase(keys.back()));
+    keys.pop_back();
+  }
+  ASSERT_TRUE(filter.insert(1));
+  keys.push_back(1);
+  for (auto k : keys) {
+    ASSERT_TRUE(filter.find(k));
+  }
+}
@@ -0,0 +1,158 @@
+#include <ctime>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "falcon/sets/dense_map.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kMinSize = 1 << 5;
+constexpr size_t kMaxSize = 1 << 15;
+constexpr size_t kLookups = 1 << 10;
+
+struct ModHash {
+  uint64_t operator()(uint32_t k) const { return k % 1021; }
+};
+} // namespace
+
+TEST(DenseMap, Simple) {
+  DenseMap<std::string, int> m;
+  auto [it, inserted] = m.try_emplace("a", 1);
+  ASSERT_TRUE(inserted);
+  ASSERT_EQ(it->first, "a");
+  ASSERT_EQ(it->second, 1);
+
+  std::tie(it, inserted) = m.try_emplace("a", 2);
+  ASSERT_FALSE(inserted);
+  ASSERT_EQ(it->second, 1);
+
+  m["b"] += 5;
+  m["b"] += 5;
+  ASSERT_EQ(*m.find("b"), 10);
+  ASSERT_EQ(m.find("c"), nullptr);
+  ASSERT_EQ(m.size(), 2);
+
+  ASSERT_EQ(m.erase("a"), 1);
+  ASSERT_EQ(m.erase("a"), 0);
+  ASSERT_EQ(m.find("a"), nullptr);
+  ASSERT_EQ(m.size(), 1);
+
+  size_t n = 0;
+  for (const auto &[k, v] : m) {
+    ASSERT_EQ(k, "b");
+    ASSERT_EQ(v, 10);
+    ++n;
+  }
+  ASSERT_EQ(n, 1);
+}
+
+TEST(DenseMap, ConstKey) {
+  typedef DenseMap<std::string, int> map_t;
+  static_assert(std::is_same_v<decltype(*std::declval<map_t::iterator>()),
+                               std::pair<const std::string, int> &>);
+  static_assert(
+      std::is_same_v<decltype(*std::declval<map_t::const_iterator>()),
+                     const std::pair<const std::string, int> &>);
+
+  map_t m;
+  for (int i = 0; i < 100; ++i) {
+    m[std::to_string(i)] = i;
+  }
+  for (auto &[k, v] : m) {
+    v += 1;
+  }
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(*m.find(std::to_string(i)), i + 1);
+  }
+}
+
+TEST(DenseMap, Test) {
+  static std::mt19937 rng(time(NULL));
+  for (size_t n = kMinSize; n <= kMaxSize; n <<= 1) {
+    // A deliberately poor hash so that chains are long and collide.
+    DenseMap<uint32_t, uint32_t, ModHash> dmap;
+    std::unordered_map<uint32_t, uint32_t> umap;
+    for (size_t i = 0; i < n; ++i) {
+      auto k = rng() % (n * 2);
+      ++dmap[k];
+      ++umap[k];
+    }
+    ASSERT_EQ(dmap.size(), umap.size());
+    for (const auto &[k, v] : umap) {
+      ASSERT_EQ(*dmap.find(k), v);
+    }
+
+    for (size_t i = 0; i < n; i += 2) {
+      ASSERT_EQ(dmap.erase(i), umap.erase(i));
+    }
+    ASSERT_EQ(dmap.size(), umap.size());
+
+    size_t iterated = 0;
+    for (const auto &[k, v] : dmap) {
+      ASSERT_EQ(umap.at(k), v);
+      ++iterated;
+    }
+    ASSERT_EQ(iterated, umap.size());
+
+    for (size_t i = 0; i < kLookups; ++i) {
+      auto lookup = rng() % (n * 2);
+      auto expected = umap.find(lookup);
+      auto actual = dmap.find(lookup);
+      if (expected == umap.end()) {
+        ASSERT_EQ(actual, nullptr);
+      } else {
+        ASSERT_EQ(*actual, expected->second);
+      }
+    }
+  }
+}
+
+TEST(DenseMap, TryEmplace) {
+  DenseMap<uint32_t, uint32_t> m;
+  uint32_t k = 0;
+  while (m.size() < m.capacity() * 7 / 8) {
+    m[k++] = 0;
+  }
+  // The next insert would grow the table, but hits must not.
+  const size_t capacity = m.capacity();
+  for (uint32_t i = 0; i < k; ++i) {
+    ASSERT_FALSE(m.try_emplace(i, 1).second);
+    ++m[i];
+  }
+  ASSERT_EQ(m.capacity(), capacity);
+  ASSERT_EQ(*m.find(0), 1);
+
+  ASSERT_TRUE(m.try_emplace(k, 7).second);
+  ASSERT_GT(m.capacity(), capacity);
+  ASSERT_EQ(*m.find(k), 7);
+}
+
+TEST(DenseMap, ThrowingValue) {
+  struct Throws {
+    Throws() = default;
+    explicit Throws(bool doThrow) {
+      if (doThrow) {
+        throw std::runtime_error("Throws");
+      }
+    }
+  };
+
+  DenseMap<std::string, Throws> m;
+  m.try_emplace("a", false);
+  ASSERT_THROW(m.try_emplace("b", true), std::runtime_error);
+  ASSERT_EQ(m.size(), 1);
+  ASSERT_EQ(m.find("b"), nullptr);
+  size_t n = 0;
+  for (const auto &kv : m) {
+    ASSERT_EQ(kv.first, "a");
+    ++n;
+  }
+  ASSERT_EQ(n, 1);
+}
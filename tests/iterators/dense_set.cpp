@@ -1,6 +1,10 @@
 #include <ctime>
+#include <memory>
 #include <random>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "falcon/sets/dense_set.h"
 
@@ -65,3 +69,95 @@ TEST(DenseSet, Test) {
     }
   }
 }
+
+TEST(DenseSet, Iterate) {
+  typedef DenseSet<uint32_t> set_t;
+  static_assert(std::is_same_v<set_t::iterator, set_t::const_iterator>);
+  static_assert(std::is_same_v<decltype(*std::declval<set_t &>().begin()),
+                               const uint32_t &>);
+
+  auto [dset, uset] = testCase(kMaxSize);
+  std::unordered_set<uint32_t> seen;
+  for (auto k : dset) {
+    ASSERT_TRUE(seen.insert(k).second);
+  }
+  ASSERT_EQ(seen, uset);
+}
+
+TEST(DenseSet, Batch) {
+  static std::mt19937 rng(time(NULL) / 3);
+  for (size_t n = kMinSize; n <= kMaxSize; n <<= 1) {
+    std::vector<uint32_t> keys(n);
+    std::unordered_set<uint32_t> uset;
+    for (auto &k : keys) {
+      k = rng();
+      uset.insert(k);
+    }
+
+    DenseSet<uint32_t> dset;
+    ASSERT_EQ(dset.insertBatch(keys.data(), keys.size()), uset.size());
+    ASSERT_EQ(dset.insertBatch(keys.data(), keys.size()), 0);
+    ASSERT_EQ(dset.size(), uset.size());
+
+    std::vector<uint32_t> lookups(keys.begin(), keys.end());
+    for (size_t i = 0; i < kLookups; ++i) {
+      lookups.push_back(rng());
+    }
+    std::unique_ptr<bool[]> found(new bool[lookups.size()]);
+    dset.findBatch(lookups.data(), lookups.size(), found.get());
+    for (size_t i = 0; i < lookups.size(); ++i) {
+      ASSERT_EQ(found[i], uset.find(lookups[i]) != uset.end());
+    }
+  }
+}
+
+TEST(DenseSet, Churn) {
+  static std::mt19937 rng(time(NULL) / 5);
+  constexpr size_t kLive = 1 << 12;
+
+  DenseSet<uint32_t> dset;
+  std::unordered_set<uint32_t> uset;
+  std::vector<uint32_t> live;
+  for (size_t i = 0; i < kLive; ++i) {
+    live.push_back(rng());
+    dset.insert(live.back());
+    uset.insert(live.back());
+  }
+  const size_t capacity = dset.capacity();
+
+  // Replace the live keys many times over. Tombstones must be compacted away
+  // rather than growing the table.
+  for (size_t i = 0; i < kMaxSize * 4; ++i) {
+    auto &k = live[rng() % kLive];
+    ASSERT_EQ(dset.erase(k), uset.erase(k));
+    k = rng();
+    dset.insert(k);
+    uset.insert(k);
+  }
+  ASSERT_EQ(dset.size(), uset.size());
+  ASSERT_LE(dset.capacity(), capacity * 2);
+  for (auto k : uset) {
+    ASSERT_TRUE(dset.find(k));
+  }
+
+  // Reinserting a key after erasing a key earlier in its chain must not
+  // create a duplicate.
+  for (auto k : live) {
+    dset.insert(k);
+  }
+  ASSERT_EQ(dset.size(), uset.size());
+
+  for (size_t i = 0; i < live.size(); i += 2) {
+    ASSERT_EQ(dset.erase(live[i]), uset.erase(live[i]));
+  }
+  dset.shrinkToFit();
+  ASSERT_EQ(dset.size(), uset.size());
+  ASSERT_LE(dset.capacity(), capacity);
+  for (auto k : uset) {
+    ASSERT_TRUE(dset.find(k));
+  }
+  for (size_t i = 0; i < kLookups; ++i) {
+    auto lookup = rng();
+    ASSERT_EQ(dset.find(lookup), uset.find(lookup) != uset.end());
+  }
+}
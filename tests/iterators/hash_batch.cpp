@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "falcon/sets/bloom_filter.h"
+#include "falcon/sets/count_min_sketch.h"
+#include "falcon/sets/counting_bloom_filter.h"
+#include "falcon/sets/hll.h"
+#include "falcon/utils/hash.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kKeys = 1 << 14;
+// Keys [0, 2 * kKeys) are looked up, so half of them are absent.
+constexpr size_t kLookups = 2 * kKeys;
+
+struct SeededHash {
+  uint64_t seed_ = 0;
+
+  SeededHash() = default;
+  SeededHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return detail::mix64(key ^ detail::mix64(seed_ + 1));
+  }
+};
+
+template <class Key> struct MixHash {
+  uint64_t operator()(const Key &key) const { return detail::mix64(key); }
+};
+
+std::vector<uint64_t> keys() {
+  std::vector<uint64_t> keys(kKeys);
+  std::iota(keys.begin(), keys.end(), 0);
+  return keys;
+}
+
+/**
+ * Inserts the keys into one filter key by key and into another through
+ * hashBatch and insertHashes, then checks that the two agree on every
+ * lookup.
+ */
+template <class Filter> void testFilter() {
+  auto ks = keys();
+  std::vector<uint64_t> hashes(kKeys);
+  SeededHash hash(0);
+  hashBatch(ks.data(), kKeys, hash, hashes.data());
+
+  Filter byKey;
+  Filter batched;
+  for (auto k : ks) {
+    byKey.insert(k);
+  }
+  batched.insertHashes(hashes.data(), kKeys);
+  for (uint64_t k = 0; k < kLookups; ++k) {
+    ASSERT_EQ(batched.find(k), byKey.find(k));
+  }
+  for (auto k : ks) {
+    ASSERT_TRUE(batched.find(k));
+  }
+}
+} // namespace
+
+TEST(HashBatch, BloomFilter) {
+  testFilter<BloomFilter<uint64_t, SeededHash>>();
+  testFilter<BlockedBloomFilter<uint64_t, SeededHash>>();
+  testFilter<BlockedBloomFilter<uint64_t, SeededHash, 1 << 20, 6>>();
+  testFilter<CountingBloomFilter<uint64_t, SeededHash>>();
+}
+
+TEST(HashBatch, CountMinSketch) {
+  auto ks = keys();
+  std::vector<uint64_t> hashes(kKeys);
+  SeededHash hash(0);
+  hashBatch(ks.data(), kKeys, hash, hashes.data());
+
+  CountMinSketch<uint64_t, SeededHash> byKey;
+  CountMinSketch<uint64_t, SeededHash> batched;
+  for (auto k : ks) {
+    byKey.insert(k);
+  }
+  batched.insertHashes(hashes.data(), kKeys);
+  for (uint64_t k = 0; k < kLookups; ++k) {
+    ASSERT_EQ(batched.count(k), byKey.count(k));
+  }
+}
+
+TEST(HashBatch, HyperLogLog) {
+  auto ks = keys();
+  std::vector<uint64_t> hashes(kKeys);
+  MixHash<uint64_t> hash;
+  hashBatch(ks.data(), kKeys, hash, hashes.data());
+
+  HyperLogLog<uint64_t, MixHash, 12> byKey;
+  HyperLogLog<uint64_t, MixHash, 12> batched;
+  // Compare after every power of two keys, through the sparse and the dense
+  // representations.
+  for (size_t n = 0; n < kKeys; n = 2 * n + 1) {
+    const size_t end = std::min(2 * n + 1, kKeys);
+    for (size_t i = n; i < end; ++i) {
+      byKey.insert(ks[i]);
+    }
+    batched.insertHashes(hashes.data() + n, end - n);
+    ASSERT_EQ(batched.isSparse(), byKey.isSparse());
+    ASSERT_EQ(batched.count(), byKey.count());
+  }
+  ASSERT_FALSE(batched.isSparse());
+}
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "falcon/sets/hll.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kLogM = 10;
+const std::string kFname = "/tmp/falcon_hll_test.hll";
+
+template <class Key> struct MixHash {
+  uint64_t operator()(const Key &key) const { return detail::mix64(key); }
+};
+
+typedef HyperLogLog<uint64_t, MixHash, kLogM> hll_t;
+typedef HyperLogLogFile<kLogM> file_t;
+
+// Flips every bit of the file's byte at offset.
+void flipByte(const std::string &fname, size_t offset) {
+  std::fstream f(fname, std::ios::binary | std::ios::in | std::ios::out);
+  f.seekg(offset);
+  char c = f.get();
+  f.seekp(offset);
+  f.put(~c);
+}
+
+/**
+ * Returns sketches of 0 to 100000 keys, the smaller ones sparse and the
+ * larger ones dense, along with their ids in no particular order.
+ */
+std::vector<std::pair<uint64_t, hll_t>> makeSketches() {
+  std::vector<std::pair<uint64_t, hll_t>> sketches;
+  uint64_t id = 1000;
+  for (size_t n : {0, 10, 100, 1000, 100000}) {
+    hll_t hll;
+    for (uint64_t i = 0; i < n; ++i) {
+      hll.insert((id << 32) | i);
+    }
+    sketches.emplace_back(id, std::move(hll));
+    id -= 7;
+  }
+  return sketches;
+}
+
+// Returns an empty sketch that has already switched to dense registers.
+hll_t makeDense() {
+  const std::vector<uint8_t> zeros(((size_t)1) << kLogM, 0);
+  hll_t hll;
+  hll.merge(HyperLogLogView<kLogM>(zeros.data(), detail::kHllDense, 1.0));
+  return hll;
+}
+
+// Returns little endian sparse entries for a view.
+std::vector<uint8_t> sparseEntries(const std::vector<uint32_t> &entries) {
+  std::vector<uint8_t> buf(4 * entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    storeLE(buf.data() + 4 * i, entries[i]);
+  }
+  return buf;
+}
+
+void write(const std::vector<std::pair<uint64_t, hll_t>> &sketches) {
+  std::vector<std::pair<uint64_t, const hll_t *>> ptrs;
+  for (const auto &[id, hll] : sketches) {
+    ptrs.emplace_back(id, &hll);
+  }
+  file_t::write(kFname, ptrs);
+}
+} // namespace
+
+TEST(HyperLogLog, Accuracy) {
+  constexpr size_t M = ((size_t)1) << kLogM;
+  const double stdError = 1.04 / std::sqrt((double)M);
+  // Below M the estimator is effectively linear counting, around 2.5M it is
+  // where raw HyperLogLog switches estimators, and far above M registers
+  // start to saturate.
+  for (size_t n : {M / 2, 5 * M / 2, M << 10}) {
+    for (uint64_t trial = 0; trial < 4; ++trial) {
+      hll_t hll;
+      for (uint64_t i = 0; i < n; ++i) {
+        hll.insert((trial << 40) | i);
+      }
+      ASSERT_NEAR((double)hll.count(), (double)n, 3 * stdError * n)
+          << "n = " << n << ", trial " << trial;
+    }
+  }
+}
+
+TEST(HyperLogLog, EmptyAndSaturated) {
+  constexpr size_t M = ((size_t)1) << kLogM;
+  constexpr uint8_t kSaturated = 64 - kLogM + 1;
+
+  hll_t hll;
+  ASSERT_EQ(hll.count(), 0);
+
+  // All-zero dense registers estimate 0 too.
+  std::vector<uint8_t> registers(M, 0);
+  HyperLogLogView<kLogM> zeros(registers.data(), detail::kHllDense, 1.0);
+  ASSERT_EQ(zeros.count(), 0);
+  hll.merge(zeros);
+  ASSERT_FALSE(hll.isSparse());
+  ASSERT_EQ(hll.count(), 0);
+
+  // With every register saturated the estimate is unbounded.
+  std::fill(registers.begin(), registers.end(), kSaturated);
+  HyperLogLogView<kLogM> saturated(registers.data(), detail::kHllDense, 1.0);
+  ASSERT_EQ(saturated.count(), std::numeric_limits<size_t>::max());
+  hll.merge(saturated);
+  ASSERT_EQ(hll.count(), std::numeric_limits<size_t>::max());
+
+  // One register short of saturation is finite again.
+  registers[0] = 1;
+  HyperLogLogView<kLogM> nearly(registers.data(), detail::kHllDense, 1.0);
+  ASSERT_LT(nearly.count(), std::numeric_limits<size_t>::max());
+  ASSERT_GT(nearly.count(), M);
+}
+
+TEST(HyperLogLog, SparseToDense) {
+  hll_t sparse;
+  hll_t dense = makeDense();
+  ASSERT_TRUE(sparse.isSparse());
+  ASSERT_FALSE(dense.isSparse());
+
+  // The sparse list holds up to M / 4 registers, after which the sketch
+  // switches to dense registers without changing its estimate.
+  bool switched = false;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    sparse.insert(i);
+    dense.insert(i);
+    switched |= !sparse.isSparse();
+    ASSERT_EQ(sparse.isSparse(), !switched);
+    ASSERT_EQ(sparse.count(), dense.count()) << i;
+  }
+  ASSERT_TRUE(switched);
+}
+
+TEST(HyperLogLog, Merge) {
+  // Small sets stay sparse and large ones go dense, and the union of two
+  // sparse sketches may or may not overflow the sparse list.
+  for (uint64_t na : {50, 200, 5000}) {
+    for (uint64_t nb : {50, 200, 5000}) {
+      hll_t all;
+      std::vector<hll_t> as(2);
+      std::vector<hll_t> bs(2);
+      as[1] = makeDense();
+      bs[1] = makeDense();
+      for (uint64_t i = 0; i < na; ++i) {
+        all.insert(i);
+        as[0].insert(i);
+        as[1].insert(i);
+      }
+      // b overlaps a by half.
+      for (uint64_t i = na / 2; i < na / 2 + nb; ++i) {
+        all.insert(i);
+        bs[0].insert(i);
+        bs[1].insert(i);
+      }
+      for (const auto &a : as) {
+        for (const auto &b : bs) {
+          hll_t merged = a;
+          merged.merge(b);
+          ASSERT_EQ(merged.count(), all.count()) << na << " " << nb;
+          if (a.isSparse() && b.isSparse() && all.isSparse()) {
+            ASSERT_TRUE(merged.isSparse());
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(HyperLogLog, MergeSparseView) {
+  constexpr uint32_t kSaturated = 64 - kLogM + 1;
+
+  // Out of order or repeated entries are rejected.
+  const std::vector<std::vector<uint32_t>> unsorted = {
+      {(2 << 8) | 1, (1 << 8) | 1}, {(2 << 8) | 1, (2 << 8) | 2}};
+  for (const auto &entries : unsorted) {
+    const auto buf = sparseEntries(entries);
+    HyperLogLogView<kLogM> view(buf.data(), entries.size(), 1.0);
+    hll_t hll;
+    ASSERT_THROW(hll.merge(view), std::runtime_error);
+  }
+
+  // Values past Q + 1 count as saturated, whether the sketch stays sparse
+  // or not.
+  const auto buf = sparseEntries({(1 << 8) | 255, (7 << 8) | 3});
+  HyperLogLogView<kLogM> view(buf.data(), 2, 1.0);
+  const auto clamped = sparseEntries({(1 << 8) | kSaturated, (7 << 8) | 3});
+  hll_t expected;
+  expected.merge(HyperLogLogView<kLogM>(clamped.data(), 2, 1.0));
+  hll_t sparse;
+  sparse.merge(view);
+  ASSERT_TRUE(sparse.isSparse());
+  ASSERT_EQ(sparse.count(), expected.count());
+  hll_t dense = makeDense();
+  dense.merge(view);
+  ASSERT_EQ(dense.count(), expected.count());
+}
+
+TEST(HyperLogLogFile, WriteAndOpen) {
+  auto sketches = makeSketches();
+  ASSERT_TRUE(sketches[1].second.isSparse());
+  ASSERT_FALSE(sketches.back().second.isSparse());
+  write(sketches);
+
+  file_t file(kFname);
+  ASSERT_EQ(file.size(), sketches.size());
+  file.verify();
+  for (size_t i = 1; i < file.size(); ++i) {
+    ASSERT_LT(file.id(i - 1), file.id(i));
+  }
+  for (const auto &[id, hll] : sketches) {
+    const size_t i = file.indexOf(id);
+    ASSERT_NE(i, file.size());
+    ASSERT_EQ(file.id(i), id);
+    auto view = file.view(i);
+    ASSERT_EQ(view.isSparse(), hll.isSparse());
+    ASSERT_EQ(view.count(), hll.count());
+
+    hll_t merged;
+    merged.merge(view);
+    ASSERT_EQ(merged.count(), hll.count());
+  }
+  ASSERT_EQ(file.indexOf(0), file.size());
+  ASSERT_EQ(file.indexOf(2000), file.size());
+
+  // None of the sketches has id 0.
+  ASSERT_THROW(hll_t::readFromDisk(kFname), std::runtime_error);
+  std::remove(kFname.c_str());
+}
+
+TEST(HyperLogLogFile, SaveAndLoad) {
+  for (const auto &[id, hll] : makeSketches()) {
+    hll.saveToDisk(kFname);
+    auto loaded = hll_t::readFromDisk(kFname);
+    ASSERT_EQ(loaded.isSparse(), hll.isSparse());
+    ASSERT_EQ(loaded.count(), hll.count());
+  }
+  std::remove(kFname.c_str());
+}
+
+TEST(HyperLogLogFile, DuplicateIds) {
+  std::vector<std::pair<uint64_t, hll_t>> sketches(2);
+  sketches[0].first = sketches[1].first = 3;
+  ASSERT_THROW(write(sketches), std::runtime_error);
+}
+
+TEST(HyperLogLogFile, Corruption) {
+  const auto sketches = makeSketches();
+
+  // A byte of the index fails the header's checksum when opening.
+  write(sketches);
+  flipByte(kFname, detail::kHllHeaderBytes + 1);
+  ASSERT_THROW(file_t file(kFname), std::runtime_error);
+
+  // A byte of a sketch only fails verify. The first sketch in the file is
+  // the one with the lowest id, the dense one.
+  write(sketches);
+  flipByte(kFname,
+           detail::kHllHeaderBytes + sketches.size() * detail::kHllEntryBytes);
+  file_t file(kFname);
+  const size_t corrupt = file.indexOf(sketches.back().first);
+  ASSERT_EQ(corrupt, 0);
+  ASSERT_THROW(file.verify(corrupt), std::runtime_error);
+  ASSERT_THROW(file.verify(), std::runtime_error);
+  ASSERT_THROW(hll_t::readFromDisk(kFname), std::runtime_error);
+  for (size_t i = 1; i < file.size(); ++i) {
+    file.verify(i);
+  }
+  std::remove(kFname.c_str());
+}
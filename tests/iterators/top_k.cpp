@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "falcon/sets/top_k.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+
+namespace {
+constexpr size_t kK = 10;
+constexpr size_t kLight = 1 << 16;
+
+struct MixHash {
+  uint64_t seed_ = 0;
+
+  MixHash() = default;
+  MixHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(uint64_t key) const {
+    return detail::mix64(key ^ detail::mix64(seed_ + 1));
+  }
+};
+
+// Checks that the heap is a min-heap by count and that the index maps every
+// tracked key, and only those, to its position in the heap.
+template <size_t K> struct CheckedTopK : public TopK<uint64_t, MixHash, K> {
+  void checkInvariants() const {
+    const auto &heap = this->heap_;
+    ASSERT_LE(heap.size(), K);
+    ASSERT_EQ(this->pos_.size(), heap.size());
+    for (size_t i = 0; i < heap.size(); ++i) {
+      if (i > 0) {
+        ASSERT_LE(heap[(i - 1) / 2].count, heap[i].count);
+      }
+      const size_t *pos = this->pos_.find(heap[i].key);
+      ASSERT_NE(pos, nullptr);
+      ASSERT_EQ(*pos, i);
+    }
+  }
+};
+
+std::vector<std::pair<uint64_t, size_t>>
+sortedTop(const std::vector<std::pair<uint64_t, size_t>> &top) {
+  auto sorted = top;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const auto &a, const auto &b) { return a.second > b.second; });
+  return sorted;
+}
+} // namespace
+
+TEST(TopK, HeavyHitters) {
+  // Heavy key h < kK appears (kK - h) * 1000 times, shuffled among kLight
+  // light keys that appear once or twice each.
+  std::vector<uint64_t> stream;
+  for (uint64_t h = 0; h < kK; ++h) {
+    stream.insert(stream.end(), (kK - h) * 1000, h);
+  }
+  for (uint64_t k = 0; k < kLight; ++k) {
+    stream.insert(stream.end(), 1 + k % 2, kK + k);
+  }
+  std::mt19937 rng(1);
+  std::shuffle(stream.begin(), stream.end(), rng);
+
+  CheckedTopK<kK> topK;
+  for (size_t i = 0; i < stream.size(); ++i) {
+    topK.insert(stream[i]);
+    if (i % 1024 == 0) {
+      topK.checkInvariants();
+    }
+  }
+  topK.checkInvariants();
+
+  const auto top = sortedTop(topK.top());
+  ASSERT_EQ(top.size(), kK);
+  for (uint64_t h = 0; h < kK; ++h) {
+    ASSERT_EQ(top[h].first, h);
+    ASSERT_GE(top[h].second, (kK - h) * 1000);
+    ASSERT_EQ(top[h].second, topK.count(h));
+  }
+}
+
+TEST(TopK, Eviction) {
+  CheckedTopK<4> topK;
+  for (uint64_t k = 1; k <= 4; ++k) {
+    topK.insert(k, 10 * k);
+    topK.checkInvariants();
+  }
+  ASSERT_EQ(topK.size(), 4);
+  // top() starts with the heap's minimum.
+  ASSERT_EQ(topK.top()[0], (std::pair<uint64_t, size_t>(1, 10)));
+
+  // A key that does not beat the minimum is not tracked.
+  topK.insert(5, 10);
+  topK.checkInvariants();
+  ASSERT_EQ(sortedTop(topK.top()),
+            (std::vector<std::pair<uint64_t, size_t>>{
+                {4, 40}, {3, 30}, {2, 20}, {1, 10}}));
+
+  // One that does replaces the minimum.
+  topK.insert(6, 25);
+  topK.checkInvariants();
+  ASSERT_EQ(sortedTop(topK.top()),
+            (std::vector<std::pair<uint64_t, size_t>>{
+                {4, 40}, {3, 30}, {6, 25}, {2, 20}}));
+
+  // A tracked key moves down the heap as its count grows.
+  topK.insert(2, 30);
+  topK.checkInvariants();
+  ASSERT_EQ(sortedTop(topK.top()),
+            (std::vector<std::pair<uint64_t, size_t>>{
+                {2, 50}, {4, 40}, {3, 30}, {6, 25}}));
+  ASSERT_EQ(topK.top()[0], (std::pair<uint64_t, size_t>(6, 25)));
+}
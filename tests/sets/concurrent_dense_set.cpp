@@ -0,0 +1,96 @@
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "falcon/io/csv.h"
+#include "falcon/sets/concurrent_dense_set.h"
+#include "falcon/sets/dense_set.h"
+
+using namespace falcon;
+
+constexpr size_t kMaxThreads = 32;
+constexpr size_t kOps = 1 << 24;
+
+/**
+ * The baseline: a single DenseSet behind one global mutex.
+ */
+class LockedDenseSet {
+  std::mutex mu_;
+  DenseSet<uint64_t> set_;
+
+public:
+  bool insert(uint64_t k) {
+    std::lock_guard<std::mutex> lock(mu_);
+    const size_t before = set_.size();
+    set_.insert(k);
+    return set_.size() != before;
+  }
+
+  bool find(uint64_t k) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return set_.find(k);
+  }
+};
+
+/**
+ * Splits keys evenly across nThreads threads that each run f on their part.
+ * Returns the wall time in seconds.
+ */
+template <class F>
+double run(size_t nThreads, const std::vector<uint64_t> &keys, F f) {
+  std::vector<std::thread> threads;
+  const size_t perThread = keys.size() / nThreads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < nThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t * perThread; i < (t + 1) * perThread; ++i) {
+        f(keys[i]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template <class Set>
+void bench(Csv<std::ostream> &writer, const std::string &name,
+           size_t nThreads, const std::vector<uint64_t> &keys) {
+  Set set;
+  auto insert = run(nThreads, keys, [&](uint64_t k) { set.insert(k); });
+  auto find = run(nThreads, keys, [&](uint64_t k) { set.find(k); });
+  writer.writeRow(name, nThreads, keys.size() / insert / 1e6,
+                  keys.size() / find / 1e6);
+}
+
+/**
+ * kOps random keys are inserted and then looked up, split evenly across
+ * 1 to kMaxThreads threads. Reports total throughput in Mops/s.
+ */
+int main() {
+  Csv writer(std::cout);
+  writer.writeRow("Set", "Threads", "Insert Mops/s", "Find Mops/s");
+
+  std::mt19937_64 rng_;
+  rng_.seed(std::time(NULL));
+  std::vector<uint64_t> keys(kOps);
+  for (auto &k : keys) {
+    k = rng_();
+  }
+
+  for (size_t nThreads = 1; nThreads <= kMaxThreads; nThreads <<= 1) {
+    bench<ConcurrentDenseSet<uint64_t>>(writer, "ConcurrentDenseSet", nThreads,
+                                        keys);
+    bench<LockedDenseSet>(writer, "Locked DenseSet", nThreads, keys);
+  }
+
+  return 0;
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <limits>
@@ -5,6 +7,8 @@
 #include <random>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "falcon/io/csv.h"
 #include "falcon/sets/count_min_sketch.h"
@@ -40,6 +44,40 @@ public:
   }
 };
 
+/**
+ * Inserts every (key, count) and reports throughput along with the error of
+ * a sample of the keys' estimates.
+ */
+template <bool Conservative, class Counter>
+void run(Csv<std::ostream> &writer, const std::string &name,
+         const std::vector<std::pair<Buf64, size_t>> &counts) {
+  auto cm = std::make_unique<
+      CountMinSketch<Buf64, CityHash, 16, 8, Conservative, Counter>>();
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &[buf, count] : counts) {
+    cm->insert(buf, count);
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  long double totalDelta = 0;
+  long double totalPct = 0;
+  size_t maxDelta = 0;
+  size_t n = 0;
+  for (size_t i = 0; i < counts.size(); i += kSample) {
+    const auto &[buf, expected] = counts[i];
+    auto delta = cm->count(buf) - expected;
+    totalDelta += delta;
+    totalPct += 100.0l * delta / std::max<size_t>(expected, 1);
+    maxDelta = std::max(maxDelta, delta);
+    ++n;
+  }
+  writer.writeRow(name, cm->sizeInBytes(),
+                  counts.size() / elapsed.count() / 1000, totalDelta / n,
+                  totalPct / n, maxDelta);
+}
+
 /**
  * Generates "random" buffers by generating a random 64 bit number and casting
  * it to a char* of length 8. Then passes this through to city to be further
@@ -47,8 +85,8 @@ public:
  */
 int main() {
   Csv writer(std::cout);
-  writer.writeRow("Count Min Sketch Count", "Actual Count", "Delta", "%");
-  auto cm = std::make_unique<CountMinSketch<Buf64, CityHash, 16, 8>>();
+  writer.writeRow("Mode", "Bytes", "M Inserts / s", "Mean Delta", "Mean %",
+                  "Max Delta");
 
   std::mt19937_64 rng_;
   rng_.seed(std::time(NULL));
@@ -58,19 +96,14 @@ int main() {
     Buf64 buf = {rng_()};
     counts.emplace(buf, rng_() % kMaxCount);
   }
-
-  for (const auto &[buf, count] : counts) {
-    cm->insert(buf, count);
-  }
-
-  size_t i = 0;
-  for (const auto &[buf, expected] : counts) {
-    if (((++i) & kSample) == 0) {
-      auto actual = cm->count(buf);
-      writer.writeRow(actual, expected, actual - expected,
-                      100.0l * (actual - expected) / expected);
-    }
-  }
+  std::vector<std::pair<Buf64, size_t>> countsVec(counts.begin(),
+                                                  counts.end());
+  counts.clear();
+
+  run<false, size_t>(writer, "standard u64", countsVec);
+  run<true, size_t>(writer, "conservative u64", countsVec);
+  run<false, uint32_t>(writer, "standard u32", countsVec);
+  run<true, uint32_t>(writer, "conservative u32", countsVec);
 
   return 0;
 }
@@ -0,0 +1,138 @@
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "falcon/io/csv.h"
+#include "falcon/sets/bloom_filter.h"
+#include "falcon/sets/cuckoo_filter.h"
+
+#include "city.h"
+
+using namespace falcon;
+
+constexpr size_t kLogBuckets = 20;
+// Fills a cuckoo filter with 2^kLogBuckets buckets to 94%.
+constexpr size_t kKeys = (((size_t)4) << kLogBuckets) * 94 / 100;
+constexpr size_t kLookups = 1 << 22;
+
+union Buf64 {
+  uint64_t x;
+  char buf[sizeof(uint64_t)];
+};
+
+class CityHash {
+  uint64_t seed_ = 0;
+
+public:
+  CityHash() = default;
+  CityHash(uint64_t seed) : seed_(seed) {}
+
+  CityHash &operator=(CityHash &&) = default;
+
+  uint64_t operator()(const Buf64 &key) const {
+    return CityHash64WithSeed(key.buf, sizeof(uint64_t), seed_);
+  }
+};
+
+template <class F> double mopsPerSec(size_t nOps, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return nOps / elapsed.count();
+}
+
+/**
+ * Inserts the keys into filter, then looks up kLookups inserted keys and
+ * kLookups keys that were never inserted (to measure the false positive
+ * rate).
+ */
+template <class Filter>
+void bench(Csv<std::ostream> &writer, const std::string &name, Filter &filter,
+           size_t bytes, const std::vector<Buf64> &keys,
+           const std::vector<Buf64> &misses) {
+  size_t failed = 0;
+  size_t found = 0;
+  size_t falsePositives = 0;
+
+  auto insert = mopsPerSec(keys.size(), [&]() {
+    for (const auto &k : keys) {
+      if constexpr (std::is_same_v<decltype(filter.insert(k)), bool>) {
+        failed += !filter.insert(k);
+      } else {
+        filter.insert(k);
+      }
+    }
+  });
+  auto hit = mopsPerSec(kLookups, [&]() {
+    for (size_t i = 0; i < kLookups; ++i) {
+      found += filter.find(keys[i % keys.size()]);
+    }
+  });
+  auto miss = mopsPerSec(kLookups, [&]() {
+    for (const auto &k : misses) {
+      falsePositives += filter.find(k);
+    }
+  });
+
+  writer.writeRow(name, 8.0 * bytes / keys.size(),
+                  (double)falsePositives / misses.size(), insert, hit, miss,
+                  failed, kLookups - found);
+}
+
+/**
+ * Compares bloom and cuckoo filters of roughly the same size, at ~8 and ~16
+ * bits per key.
+ */
+int main() {
+  Csv writer(std::cout);
+  writer.writeRow("Filter", "Bits/Key", "FPR", "Insert Mops/s",
+                  "Find Hit Mops/s", "Find Miss Mops/s", "Failed Inserts",
+                  "False Negatives");
+
+  std::mt19937_64 rng_;
+  rng_.seed(std::time(NULL));
+  std::vector<Buf64> keys(kKeys);
+  for (auto &k : keys) {
+    k = {rng_()};
+  }
+  std::vector<Buf64> misses(kLookups);
+  for (auto &k : misses) {
+    k = {rng_()};
+  }
+
+  constexpr size_t kBits8 = ((size_t)32) << kLogBuckets;
+  constexpr size_t kBits16 = ((size_t)64) << kLogBuckets;
+
+  {
+    auto bf = std::make_unique<BloomFilter<Buf64, CityHash, kBits8, 6>>();
+    bench(writer, "BloomFilter k=6", *bf, kBits8 / 8, keys, misses);
+  }
+  {
+    auto bf = std::make_unique<BlockedBloomFilter<Buf64, CityHash, kBits8, 6>>();
+    bench(writer, "BlockedBloomFilter k=6", *bf, kBits8 / 8, keys, misses);
+  }
+  {
+    CuckooFilter<Buf64, CityHash, uint8_t> cf(kKeys);
+    bench(writer, "CuckooFilter 8 bit", cf, cf.sizeInBytes(), keys, misses);
+  }
+  {
+    auto bf = std::make_unique<BloomFilter<Buf64, CityHash, kBits16, 11>>();
+    bench(writer, "BloomFilter k=11", *bf, kBits16 / 8, keys, misses);
+  }
+  {
+    auto bf =
+        std::make_unique<BlockedBloomFilter<Buf64, CityHash, kBits16, 8>>();
+    bench(writer, "BlockedBloomFilter k=8", *bf, kBits16 / 8, keys, misses);
+  }
+  {
+    CuckooFilter<Buf64, CityHash, uint16_t> cf(kKeys);
+    bench(writer, "CuckooFilter 16 bit", cf, cf.sizeInBytes(), keys, misses);
+  }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "falcon/io/csv.h"
+#include "falcon/sets/dense_map.h"
+
+#include "city.h"
+
+using namespace falcon;
+
+constexpr size_t kMinSize = 1000000;
+constexpr size_t kMaxSize = 100000000;
+constexpr size_t kLookups = 1 << 22;
+
+union Buf64 {
+  uint64_t x;
+  char buf[sizeof(uint64_t)];
+
+  template <class Buf64_> bool operator==(Buf64_ other) const {
+    return x == other.x;
+  }
+};
+
+class CityHash {
+  uint64_t seed_ = 0;
+
+public:
+  CityHash() = default;
+  CityHash(uint64_t seed) : seed_(seed) {}
+
+  uint64_t operator()(const Buf64 &key) const {
+    return CityHash64WithSeed(key.buf, sizeof(uint64_t), seed_);
+  }
+};
+
+template <class F> double nsPerOp(size_t nOps, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / nOps;
+}
+
+template <class Map> const size_t *lookup(const Map &map, const Buf64 &k) {
+  return map.find(k);
+}
+
+const size_t *lookup(const std::unordered_map<Buf64, size_t, CityHash> &map,
+                     const Buf64 &k) {
+  auto it = map.find(k);
+  return it == map.end() ? nullptr : &it->second;
+}
+
+/**
+ * Counts n random keys (each inserted twice through operator[]), then looks up
+ * kLookups present keys and kLookups absent ones.
+ */
+template <class Map>
+void bench(Csv<std::ostream> &writer, const std::string &name,
+           const std::vector<Buf64> &keys, const std::vector<Buf64> &misses) {
+  Map map;
+  size_t sum = 0;
+
+  auto insert = nsPerOp(keys.size() * 2, [&]() {
+    for (const auto &k : keys) {
+      ++map[k];
+    }
+    for (const auto &k : keys) {
+      ++map[k];
+    }
+  });
+  auto hit = nsPerOp(kLookups, [&]() {
+    for (size_t i = 0; i < kLookups; ++i) {
+      sum += *lookup(map, keys[i % keys.size()]);
+    }
+  });
+  auto miss = nsPerOp(kLookups, [&]() {
+    for (size_t i = 0; i < kLookups; ++i) {
+      sum += lookup(map, misses[i]) != nullptr;
+    }
+  });
+
+  writer.writeRow(name, keys.size(), insert, hit, miss, sum);
+}
+
+/**
+ * Keys are random 64 bit numbers hashed with city, the same as cms_bench.
+ */
+int main() {
+  Csv writer(std::cout);
+  writer.writeRow("Map", "N", "Upsert ns/op", "Find Hit ns/op",
+                  "Find Miss ns/op", "Checksum");
+
+  std::mt19937_64 rng_;
+  rng_.seed(std::time(NULL));
+
+  std::vector<Buf64> misses(kLookups);
+  for (auto &k : misses) {
+    k = {rng_()};
+  }
+
+  for (size_t n = kMinSize; n <= kMaxSize; n *= 10) {
+    std::vector<Buf64> keys(n);
+    for (auto &k : keys) {
+      k = {rng_()};
+    }
+
+    bench<DenseMap<Buf64, size_t, CityHash>>(writer, "DenseMap", keys, misses);
+    bench<std::unordered_map<Buf64, size_t, CityHash>>(
+        writer, "std::unordered_map", keys, misses);
+  }
+
+  return 0;
+}
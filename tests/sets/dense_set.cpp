@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "falcon/io/csv.h"
+#include "falcon/sets/dense_set.h"
+#include "falcon/sets/swiss_set.h"
+
+using namespace falcon;
+
+constexpr size_t kMinSize = 1 << 10;
+constexpr size_t kMaxSize = 1 << 24;
+constexpr size_t kLookups = 1 << 22;
+
+template <class F> double nsPerOp(size_t nOps, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / nOps;
+}
+
+template <class Set> bool contains(const Set &set, uint64_t k) {
+  return set.find(k);
+}
+
+bool contains(const std::unordered_set<uint64_t> &set, uint64_t k) {
+  return set.find(k) != set.end();
+}
+
+/**
+ * Inserts n random keys, then does kLookups lookups of keys known to be in
+ * the set followed by kLookups lookups of (almost certainly) absent keys.
+ */
+template <class Set>
+void bench(Csv<std::ostream> &writer, const std::string &name,
+           const std::vector<uint64_t> &keys,
+           const std::vector<uint64_t> &misses) {
+  Set set;
+  size_t found = 0;
+
+  auto insert = nsPerOp(keys.size(), [&]() {
+    for (auto k : keys) {
+      set.insert(k);
+    }
+  });
+  auto hit = nsPerOp(kLookups, [&]() {
+    for (size_t i = 0; i < kLookups; ++i) {
+      found += contains(set, keys[i % keys.size()]);
+    }
+  });
+  auto miss = nsPerOp(kLookups, [&]() {
+    for (size_t i = 0; i < kLookups; ++i) {
+      found += contains(set, misses[i]);
+    }
+  });
+
+  writer.writeRow(name, keys.size(), insert, hit, miss, found);
+}
+
+/**
+ * Same as bench but goes through DenseSet's batched APIs.
+ */
+void benchBatch(Csv<std::ostream> &writer, const std::vector<uint64_t> &keys,
+                const std::vector<uint64_t> &misses) {
+  DenseSet<uint64_t> set;
+  std::unique_ptr<bool[]> out(new bool[kLookups]);
+  std::vector<uint64_t> hits(kLookups);
+  for (size_t i = 0; i < kLookups; ++i) {
+    hits[i] = keys[i % keys.size()];
+  }
+
+  auto insert =
+      nsPerOp(keys.size(), [&]() { set.insertBatch(keys.data(), keys.size()); });
+  auto hit = nsPerOp(kLookups,
+                     [&]() { set.findBatch(hits.data(), kLookups, out.get()); });
+  size_t found = std::count(out.get(), out.get() + kLookups, true);
+  auto miss = nsPerOp(
+      kLookups, [&]() { set.findBatch(misses.data(), kLookups, out.get()); });
+  found += std::count(out.get(), out.get() + kLookups, true);
+
+  writer.writeRow("DenseSet (batch)", keys.size(), insert, hit, miss, found);
+}
+
+int main() {
+  Csv writer(std::cout);
+  writer.writeRow("Set", "N", "Insert ns/op", "Find Hit ns/op",
+                  "Find Miss ns/op", "Found");
+
+  std::mt19937_64 rng_;
+  rng_.seed(std::time(NULL));
+
+  std::vector<uint64_t> misses(kLookups);
+  for (auto &k : misses) {
+    k = rng_();
+  }
+
+  for (size_t n = kMinSize; n <= kMaxSize; n <<= 2) {
+    std::vector<uint64_t> keys(n);
+    for (auto &k : keys) {
+      k = rng_();
+    }
+    std::shuffle(misses.begin(), misses.end(), rng_);
+
+    bench<DenseSet<uint64_t>>(writer, "DenseSet", keys, misses);
+    benchBatch(writer, keys, misses);
+    bench<SwissSet<uint64_t>>(writer, "SwissSet", keys, misses);
+    bench<std::unordered_set<uint64_t>>(writer, "std::unordered_set", keys,
+                                        misses);
+  }
+
+  return 0;
+}
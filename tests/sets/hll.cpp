@@ -1,10 +1,15 @@
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <limits>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "falcon/io/csv.h"
+#include "falcon/sets/concurrent_hll.h"
 #include "falcon/sets/hll.h"
 
 #include "city.h"
@@ -14,6 +19,12 @@ using namespace falcon;
 constexpr int64_t lb = 1 << 20;
 constexpr int64_t ub = 1ll << 34;
 
+// Report at every power of 2 below lb, where small-range error shows up, and
+// then every million.
+bool shouldReport(int64_t n) {
+  return n < lb ? (n & (n - 1)) == 0 : n % 1000000 == 0;
+}
+
 // Generate random numbers and feed them to the HLL algorithm. Each
 // call should generate a unique "hash" and we can see how close the
 // count is to actual number of calls.
@@ -30,11 +41,11 @@ int main_rng() {
   std::mt19937 rng;
   Csv writer(std::cout);
   writer.writeRow("HLL Count", "Actual Count", "Delta", "%");
-  HyperLogLog<std::string, RngHash, 16> hll(0.3l / 0.68l + 1.0l);
+  HyperLogLog<std::string, RngHash, 16> hll;
   for (size_t i = 0; i < ub; ++i) {
     hll.insert("hello");
     int64_t n = i + 1;
-    if (n % 1000000 == 0) {
+    if (shouldReport(n)) {
       int64_t count = hll.count();
       writer.writeRow(count, n, count - n, 100.0l * (count - n) / n);
     }
@@ -62,7 +73,7 @@ public:
 int main_city() {
   Csv writer(std::cout);
   writer.writeRow("HLL Count", "Actual Count", "Delta", "%");
-  HyperLogLog<Buf64, CityHash, 16> hll(0.3l / 0.68l + 1.0l);
+  HyperLogLog<Buf64, CityHash, 16> hll;
 
   std::mt19937_64 rng_;
   rng_.seed(std::time(NULL));
@@ -71,7 +82,7 @@ int main_city() {
     Buf64 buf = {rng_()};
     hll.insert(buf);
     int64_t n = i + 1;
-    if (n % 1000000 == 0) {
+    if (shouldReport(n)) {
       int64_t count = hll.count();
       writer.writeRow(count, n, count - n, 100.0l * (count - n) / n);
     }
@@ -79,4 +90,150 @@ int main_city() {
   return 0;
 }
 
-int main() { return main_city(); }
+/**
+ * Builds many small sketches, as a per-key HLL would see, and reports how
+ * much memory each one takes and how accurate the merge of all of them is.
+ */
+int main_sparse() {
+  Csv writer(std::cout);
+  writer.writeRow("Items Per Sketch", "Bytes Per Sketch", "Sparse %",
+                  "Merged Count", "Actual Count", "%");
+
+  for (size_t items = 4; items <= (1 << 16); items <<= 2) {
+    const size_t nSketches = std::min<size_t>(1 << 14, (1 << 26) / items);
+    HyperLogLog<Buf64, CityHash, 16> merged;
+    size_t bytes = 0;
+    size_t nSparse = 0;
+    // Sketch i holds the items i * items / 2 + [0, items), so neighbouring
+    // sketches overlap by half.
+    for (size_t i = 0; i < nSketches; ++i) {
+      HyperLogLog<Buf64, CityHash, 16> hll;
+      for (size_t j = 0; j < items; ++j) {
+        Buf64 buf = {i * items / 2 + j};
+        hll.insert(buf);
+      }
+      bytes += hll.sizeInBytes();
+      nSparse += hll.isSparse();
+      merged.merge(hll);
+    }
+    int64_t actual = (nSketches - 1) * items / 2 + items;
+    int64_t count = merged.count();
+    writer.writeRow(items, bytes / nSketches, 100.0 * nSparse / nSketches,
+                    count, actual, 100.0l * (count - actual) / actual);
+  }
+  return 0;
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/**
+ * Writes many sketches of mixed sizes to one file and times reloading them:
+ * mapping the file and estimating every sketch through a view, verifying
+ * every checksum, and copying every sketch into a HyperLogLog.
+ */
+int main_file() {
+  constexpr size_t nSketches = 1 << 15;
+  const std::string fname = "/tmp/hll_bench.hll";
+  typedef HyperLogLog<Buf64, CityHash, 16> hll_t;
+
+  std::vector<hll_t> hlls(nSketches);
+  std::vector<std::pair<uint64_t, const hll_t *>> sketches;
+  for (size_t i = 0; i < nSketches; ++i) {
+    // Mostly small sketches with a dense one every 256.
+    const size_t items = i % 256 == 0 ? 1 << 17 : i % 1024;
+    for (size_t j = 0; j < items; ++j) {
+      Buf64 buf = {(i << 32) | j};
+      hlls[i].insert(buf);
+    }
+    sketches.emplace_back(i, &hlls[i]);
+  }
+
+  Csv writer(std::cout);
+  writer.writeRow("Sketches", "Write ms", "Open + Count ms", "Verify ms",
+                  "Copy ms");
+
+  auto start = std::chrono::steady_clock::now();
+  HyperLogLogFile<16>::write(fname, sketches);
+  const double writeMs = msSince(start);
+
+  start = std::chrono::steady_clock::now();
+  size_t total = 0;
+  {
+    HyperLogLogFile<16> file(fname);
+    for (size_t i = 0; i < file.size(); ++i) {
+      total += file.view(i).count();
+    }
+  }
+  const double openMs = msSince(start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    HyperLogLogFile<16> file(fname);
+    file.verify();
+  }
+  const double verifyMs = msSince(start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    HyperLogLogFile<16> file(fname);
+    for (size_t i = 0; i < file.size(); ++i) {
+      hlls[i].reset();
+      hlls[i].merge(file.view(i));
+    }
+  }
+  const double copyMs = msSince(start);
+
+  writer.writeRow(nSketches, writeMs, openMs, verifyMs, copyMs);
+  std::cerr << "Total count " << total << std::endl;
+  return 0;
+}
+
+/**
+ * Inserts the same keys through ConcurrentHyperLogLog::parallelInsert with
+ * 1, 2, 4, ... threads up to the number of cores.
+ */
+int main_threads() {
+  constexpr size_t nKeys = 1 << 24;
+  std::vector<Buf64> keys(nKeys);
+  std::mt19937_64 rng_;
+  rng_.seed(std::time(NULL));
+  for (auto &key : keys) {
+    key.x = rng_();
+  }
+
+  Csv writer(std::cout);
+  writer.writeRow("Threads", "ms", "M Inserts / s", "HLL Count",
+                  "Actual Count", "%");
+  const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t nThreads = 1;; nThreads = std::min(nThreads * 2, maxThreads)) {
+    ConcurrentHyperLogLog<Buf64, CityHash, 16> hll;
+    auto start = std::chrono::steady_clock::now();
+    hll.parallelInsert(keys.begin(), keys.end(), nThreads);
+    const double ms = msSince(start);
+    int64_t count = hll.count();
+    int64_t n = nKeys;
+    writer.writeRow(nThreads, ms, nKeys / ms / 1000, count, n,
+                    100.0l * (count - n) / n);
+    if (nThreads == maxThreads) {
+      break;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "sparse") {
+    return main_sparse();
+  }
+  if (argc > 1 && std::string(argv[1]) == "file") {
+    return main_file();
+  }
+  if (argc > 1 && std::string(argv[1]) == "threads") {
+    return main_threads();
+  }
+  return main_city();
+}
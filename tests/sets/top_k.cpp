@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "falcon/io/csv.h"
+#include "falcon/sets/top_k.h"
+
+#include "city.h"
+
+using namespace falcon;
+
+constexpr size_t kK = 100;
+constexpr size_t kUniverse = 1 << 20;
+constexpr size_t kInserts = 1 << 24;
+constexpr double kZipfS = 1.1;
+
+union Buf64 {
+  uint64_t x;
+  char buf[sizeof(uint64_t)];
+
+  bool operator==(const Buf64 &other) const { return x == other.x; }
+};
+
+class CityHash {
+  uint64_t seed_ = 0;
+
+public:
+  CityHash() = default;
+  CityHash(uint64_t seed) : seed_(seed) {}
+
+  CityHash &operator=(CityHash &&) = default;
+
+  uint64_t operator()(const Buf64 &key) const {
+    return CityHash64WithSeed(key.buf, sizeof(uint64_t), seed_);
+  }
+};
+
+/**
+ * Draws kInserts keys where the key of rank r (1-indexed) has probability
+ * proportional to 1 / r^kZipfS. Keys are scrambled ranks so that hot keys are
+ * not adjacent integers.
+ */
+std::vector<Buf64> zipfStream() {
+  std::vector<double> cdf(kUniverse);
+  double sum = 0;
+  for (size_t r = 0; r < kUniverse; ++r) {
+    sum += 1.0 / std::pow(r + 1, kZipfS);
+    cdf[r] = sum;
+  }
+
+  std::mt19937_64 rng_;
+  rng_.seed(std::time(NULL));
+  std::uniform_real_distribution<double> dist(0, sum);
+  std::vector<Buf64> stream(kInserts);
+  for (auto &key : stream) {
+    size_t r = std::lower_bound(cdf.begin(), cdf.end(), dist(rng_)) -
+               cdf.begin();
+    key.x = (r + 1) * 0x9e3779b97f4a7c15ull;
+  }
+  return stream;
+}
+
+template <class F> double elapsedUs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+/**
+ * Compares TopK against counting every key exactly in an unordered_map and
+ * partially sorting it on query. Recall is the fraction of the true top kK
+ * keys that TopK reports.
+ */
+int main() {
+  const auto stream = zipfStream();
+
+  Csv writer(std::cout);
+  writer.writeRow("Tracker", "M Inserts / s", "Query us", "Recall %",
+                  "Mean Count Error %");
+
+  std::unordered_map<uint64_t, size_t> exact;
+  double insertUs = elapsedUs([&] {
+    for (const auto &key : stream) {
+      ++exact[key.x];
+    }
+  });
+  std::vector<std::pair<size_t, uint64_t>> exactTop;
+  double queryUs = elapsedUs([&] {
+    exactTop.clear();
+    for (const auto &[key, count] : exact) {
+      exactTop.emplace_back(count, key);
+    }
+    std::partial_sort(exactTop.begin(), exactTop.begin() + kK, exactTop.end(),
+                      std::greater<std::pair<size_t, uint64_t>>());
+    exactTop.resize(kK);
+  });
+  writer.writeRow("unordered_map", kInserts / insertUs, queryUs, 100, 0);
+
+  TopK<Buf64, CityHash, kK> topK;
+  insertUs = elapsedUs([&] {
+    for (const auto &key : stream) {
+      topK.insert(key);
+    }
+  });
+  std::vector<std::pair<Buf64, size_t>> top;
+  // Sorted like exactTop, so that both query times include ordering.
+  queryUs = elapsedUs([&] {
+    top = topK.top();
+    std::sort(top.begin(), top.end(), [](const auto &a, const auto &b) {
+      return a.second > b.second;
+    });
+  });
+
+  std::unordered_set<uint64_t> trueTop;
+  for (const auto &[count, key] : exactTop) {
+    trueTop.insert(key);
+  }
+  size_t hits = 0;
+  long double totalError = 0;
+  for (const auto &[key, estimate] : top) {
+    if (trueTop.count(key.x)) {
+      ++hits;
+    }
+    const size_t actual = exact[key.x];
+    totalError += 100.0l * (estimate - actual) / actual;
+  }
+  writer.writeRow("TopK", kInserts / insertUs, queryUs, 100.0 * hits / kK,
+                  totalError / top.size());
+
+  return 0;
+}
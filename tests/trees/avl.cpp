@@ -9,3 +9,30 @@ using namespace falcon::tests;
 TEST(AVLTree, Simple) { simpleTest<AVLTree>(); }
 
 TEST(AVLTree, Test) { testInsert<AVLTree>(); }
+
+TEST(AVLTree, Erase) { testErase<AVLTree>(); }
+
+TEST(AVLTree, Handles) { testHandles<AVLTree>(); }
+
+TEST(AVLTree, Range) { testRange<AVLTree>(); }
+
+TEST(AVLTree, FromSorted) { testFromSorted<AVLTree>(); }
+
+template <class Key, class Val>
+using AVLTreeStdAlloc = AVLTree<Key, Val, std::allocator>;
+
+TEST(AVLTree, StdAllocator) {
+  simpleTest<AVLTreeStdAlloc>();
+  testInsert<AVLTreeStdAlloc>();
+  testErase<AVLTreeStdAlloc>();
+}
+
+template <class Key, class Val>
+using AVLTreeOrderStats = AVLTree<Key, Val, NodeArena, true>;
+
+TEST(AVLTree, OrderStats) {
+  testErase<AVLTreeOrderStats>();
+  testRange<AVLTreeOrderStats>();
+  testOrderStats<AVLTreeOrderStats>();
+  testFromSorted<AVLTreeOrderStats>();
+}
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <iterator>
+#include <map>
 #include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 #include "falcon/iterators/tree.h"
 #include "falcon/trees/bst.h"
+#include "falcon/trees/redblack.h"
 #include "gtest/gtest.h"
 
 namespace falcon {
@@ -13,6 +20,9 @@ namespace tests {
 constexpr size_t kMinSize = 1 << 5;
 constexpr size_t kMaxSize = 1 << 15;
 constexpr size_t kLookups = 1 << 10;
+// Trees up to this size are checked with checkInvariants after every
+// operation; larger ones after every n / kMaxChecked-th, to stay O(n).
+constexpr size_t kMaxChecked = 1 << 10;
 
 /**
  * Input: Binary tree
@@ -26,6 +36,115 @@ template <class BST> bool isBst(const BST &t) {
   return std::is_sorted(vec.begin(), vec.end());
 }
 
+template <class Node, class = void> struct HasHeight : std::false_type {};
+template <class Node>
+struct HasHeight<Node, std::void_t<decltype(Node::height)>> : std::true_type {
+};
+
+template <class Node, class = void> struct HasColor : std::false_type {};
+template <class Node>
+struct HasColor<Node, std::void_t<decltype(Node::color)>> : std::true_type {};
+
+template <class Node, class = void> struct HasSize : std::false_type {};
+template <class Node>
+struct HasSize<Node, std::void_t<decltype(Node::size)>> : std::true_type {};
+
+// Reads the protected root of a tree.
+template <class BST> struct RootAccess : public BST {
+  static auto root(const BST &t) { return t.*(&RootAccess::root_); }
+};
+
+/**
+ * Checks the subtree rooted at node, whose parent should be parent, and sets
+ * height, blackHeight (the number of black nodes on every path down from
+ * node, for red-black nodes) and size.
+ */
+template <class Node>
+::testing::AssertionResult checkSubtree(const Node *node, const Node *parent,
+                                        size_t &height, size_t &blackHeight,
+                                        size_t &size) {
+  height = blackHeight = size = 0;
+  if (node == nullptr) {
+    return ::testing::AssertionSuccess();
+  }
+  const auto key = node->data.first;
+  if (node->parent != parent) {
+    return ::testing::AssertionFailure() << "bad parent link at " << key;
+  }
+
+  size_t lh, lbh, ls, rh, rbh, rs;
+  auto left = checkSubtree(node->left, node, lh, lbh, ls);
+  if (!left) {
+    return left;
+  }
+  auto right = checkSubtree(node->right, node, rh, rbh, rs);
+  if (!right) {
+    return right;
+  }
+  height = std::max(lh, rh) + 1;
+  size = ls + rs + 1;
+
+  if constexpr (HasHeight<Node>::value) {
+    if ((size_t)node->height != height) {
+      return ::testing::AssertionFailure()
+             << "stored height " << node->height << " at " << key
+             << " should be " << height;
+    }
+    if (lh > rh + 1 || rh > lh + 1) {
+      return ::testing::AssertionFailure()
+             << "subtree heights " << lh << " and " << rh << " at " << key;
+    }
+  }
+  if constexpr (HasColor<Node>::value) {
+    if (lbh != rbh) {
+      return ::testing::AssertionFailure()
+             << "black heights " << lbh << " and " << rbh << " at " << key;
+    }
+    const bool red = node->color == detail::Color::Red;
+    for (auto child : {node->left, node->right}) {
+      if (red && child && child->color == detail::Color::Red) {
+        return ::testing::AssertionFailure() << "red child of red " << key;
+      }
+    }
+    blackHeight = lbh + !red;
+  }
+  if constexpr (HasSize<Node>::value) {
+    if (node->size != size) {
+      return ::testing::AssertionFailure()
+             << "stored size " << node->size << " at " << key
+             << " should be " << size;
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+/**
+ * Checks every parent link and that size() matches the tree. Depending on
+ * the node type also checks AVL balance and stored heights, the red-black
+ * rules (black root, no red node with a red child, the same number of black
+ * nodes on every path), and OrderStats subtree sizes. O(n).
+ */
+template <class BST> ::testing::AssertionResult checkInvariants(const BST &t) {
+  const auto root = RootAccess<BST>::root(t);
+  size_t height, blackHeight, size;
+  auto result = checkSubtree(root, decltype(root)(nullptr), height,
+                             blackHeight, size);
+  if (!result) {
+    return result;
+  }
+  if (size != t.size()) {
+    return ::testing::AssertionFailure()
+           << size << " nodes but size() is " << t.size();
+  }
+  typedef std::remove_pointer_t<decltype(root)> node_t;
+  if constexpr (HasColor<node_t>::value) {
+    if (root && root->color != detail::Color::Black) {
+      return ::testing::AssertionFailure() << "red root";
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
 template <template <typename, typename> class BST> void simpleTest() {
   BST<int, int> t;
   std::array<std::pair<int, int>, 6> testCases = {
@@ -54,7 +173,7 @@ testCase(size_t n) {
     auto key = rng();
     auto val = rng();
     tree.emplace(key, val);
-    map.emplace(key, val);
+    map[key] = val;
   }
   return {std::move(tree), std::move(map)};
 }
@@ -82,5 +201,269 @@ template <template <typename, typename> class BST> void testInsert() {
     }
   }
 }
+
+/**
+ * Erases and extracts random keys, some present and some not, reinserting
+ * half of the extracted nodes under a new key, and checks the tree against
+ * a std::map after every operation. checkInvariants runs after every
+ * operation too while the tree is small (see kMaxChecked).
+ */
+template <template <typename, typename> class BST> void testErase() {
+  static std::mt19937 rng(time(NULL) / 3);
+  for (size_t n = kMinSize; n <= kMaxSize; n <<= 1) {
+    auto [tree, map] = testCase<BST>(n);
+    ASSERT_TRUE(checkInvariants(tree));
+    const size_t checkEvery = std::max<size_t>(1, n / kMaxChecked);
+    std::vector<uint32_t> keys;
+    for (const auto &i : map) {
+      keys.push_back(i.first);
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+      // Every other key is one that was never inserted.
+      const uint32_t key = i % 2 ? keys[i] : rng();
+      const bool present = map.count(key);
+      if (i % 3 == 0) {
+        auto node = tree.extract(key);
+        ASSERT_EQ((bool)node, present);
+        if (node) {
+          ASSERT_EQ(node.key(), key);
+          ASSERT_EQ(node.value(), map[key]);
+          map.erase(key);
+          if (rng() % 2) {
+            node.key() = rng();
+            map[node.key()] = node.value();
+            tree.insert(std::move(node));
+          }
+        }
+      } else {
+        ASSERT_EQ(tree.erase(key), present);
+        map.erase(key);
+      }
+      ASSERT_EQ(tree.find(key) != nullptr, map.count(key) == 1);
+      ASSERT_EQ(tree.size(), map.size());
+      if (i % checkEvery == 0) {
+        ASSERT_TRUE(checkInvariants(tree));
+      }
+    }
+
+    ASSERT_TRUE(isBst(tree));
+    for (const auto &i : map) {
+      ASSERT_EQ(*tree.find(i.first), i.second);
+    }
+    size_t erased = 0;
+    for (const auto &i : map) {
+      ASSERT_TRUE(tree.erase(i.first));
+      if (++erased % checkEvery == 0) {
+        ASSERT_TRUE(checkInvariants(tree));
+      }
+    }
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_EQ(tree.find(keys[0]), nullptr);
+  }
+}
+
+/**
+ * Checks that extracted nodes stay valid when their tree is cleared or
+ * moved, and that either tree can take them back.
+ */
+template <template <typename, typename> class BST> void testHandles() {
+  typedef BST<uint32_t, uint32_t> tree_t;
+  auto [tree, map] = testCase<BST>(kMinSize);
+  std::vector<std::pair<uint32_t, uint32_t>> extracted(
+      map.begin(), std::next(map.begin(), 4));
+  std::vector<typename tree_t::node_handle_t> handles;
+  for (const auto &[key, val] : extracted) {
+    handles.push_back(tree.extract(key));
+  }
+
+  // Clearing and refilling the tree must not reuse the handles' nodes.
+  tree.clear();
+  ASSERT_EQ(tree.size(), 0);
+  for (uint32_t i = 0; i < kMinSize; ++i) {
+    tree.emplace(i, i);
+  }
+  for (size_t i = 0; i < handles.size(); ++i) {
+    ASSERT_EQ(handles[i].key(), extracted[i].first);
+    ASSERT_EQ(handles[i].value(), extracted[i].second);
+  }
+  tree.insert(std::move(handles[0]));
+  ASSERT_EQ(*tree.find(extracted[0].first), extracted[0].second);
+
+  // Handles move with the nodes to the tree moved to.
+  tree_t moved(std::move(tree));
+  ASSERT_EQ(tree.size(), 0);
+  moved.insert(std::move(handles[1]));
+  ASSERT_EQ(*moved.find(extracted[1].first), extracted[1].second);
+  // The moved from tree copies a handle it does not own.
+  tree.insert(std::move(handles[2]));
+  ASSERT_EQ(*tree.find(extracted[2].first), extracted[2].second);
+  ASSERT_TRUE(handles[2].empty());
+  handles[3].reset();
+
+  ASSERT_EQ(moved.size(), kMinSize + 2);
+  ASSERT_TRUE(checkInvariants(moved));
+  moved.clear();
+  ASSERT_EQ(moved.size(), 0);
+}
+
+/**
+ * Checks lower_bound, upper_bound, and range against std::map for random
+ * bounds, including ones equal to keys in the tree.
+ */
+template <template <typename, typename> class BST> void testRange() {
+  static std::mt19937 rng(time(NULL) / 5);
+  for (size_t n = kMinSize; n <= kMaxSize; n <<= 1) {
+    auto [tree, map] = testCase<BST>(n);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), map.begin(), map.end(),
+                           [](const auto &a, const auto &b) {
+                             return a.first == b.first &&
+                                    a.second == b.second;
+                           }));
+
+    std::vector<uint32_t> keys;
+    for (const auto &i : map) {
+      keys.push_back(i.first);
+    }
+    auto bound = [&]() -> uint32_t {
+      return rng() % 2 ? keys[rng() % keys.size()] : rng();
+    };
+
+    for (size_t i = 0; i < kLookups; ++i) {
+      const uint32_t key = bound();
+      auto lower = tree.lower_bound(key);
+      auto expectedLower = map.lower_bound(key);
+      if (expectedLower == map.end()) {
+        ASSERT_TRUE(lower == tree.end());
+      } else {
+        ASSERT_EQ(lower->first, expectedLower->first);
+      }
+      auto upper = tree.upper_bound(key);
+      auto expectedUpper = map.upper_bound(key);
+      if (expectedUpper == map.end()) {
+        ASSERT_TRUE(upper == tree.end());
+      } else {
+        ASSERT_EQ(upper->first, expectedUpper->first);
+      }
+
+      const uint32_t first = std::min(key, bound());
+      const uint32_t last = first + rng() % (UINT32_MAX / n * 64);
+      std::vector<uint32_t> actual;
+      for (const auto &data : tree.range(first, last)) {
+        actual.push_back(data.first);
+      }
+      std::vector<uint32_t> expected;
+      for (auto it = map.lower_bound(first);
+           it != map.end() && it->first < last; ++it) {
+        expected.push_back(it->first);
+      }
+      ASSERT_EQ(actual, expected);
+    }
+
+    auto empty = tree.range(keys.back(), keys.front());
+    ASSERT_TRUE(empty.begin() == empty.end());
+  }
+}
+
+/**
+ * BST must have OrderStats. Checks select and rank against the sorted keys
+ * after a mix of erases and extracts reinserted under new keys.
+ */
+template <template <typename, typename> class BST> void testOrderStats() {
+  static std::mt19937 rng(time(NULL) / 7);
+  for (size_t n = kMinSize; n <= kMaxSize; n <<= 1) {
+    auto [tree, map] = testCase<BST>(n);
+    std::vector<uint32_t> live;
+    for (const auto &i : map) {
+      live.push_back(i.first);
+    }
+    for (size_t i = 0; i < n / 2; ++i) {
+      const size_t idx = rng() % live.size();
+      const uint32_t key = live[idx];
+      live[idx] = live.back();
+      live.pop_back();
+      map.erase(key);
+      if (i % 2) {
+        tree.erase(key);
+      } else {
+        auto node = tree.extract(key);
+        node.key() = rng();
+        if (map.count(node.key()) == 0) {
+          live.push_back(node.key());
+        }
+        map[node.key()] = node.value();
+        tree.insert(std::move(node));
+      }
+    }
+    ASSERT_EQ(tree.size(), map.size());
+
+    std::vector<uint32_t> keys;
+    for (const auto &i : map) {
+      keys.push_back(i.first);
+    }
+    for (size_t k = 0; k < keys.size(); ++k) {
+      auto it = tree.select(k);
+      ASSERT_EQ(it->first, keys[k]);
+      ASSERT_EQ(tree.rank(keys[k]), k);
+    }
+    ASSERT_TRUE(tree.select(keys.size()) == tree.end());
+
+    for (size_t i = 0; i < kLookups; ++i) {
+      const uint32_t key = rng();
+      const size_t expected =
+          std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+      ASSERT_EQ(tree.rank(key), expected);
+    }
+  }
+}
+
+/**
+ * BST must have fromSorted. Builds trees of every size up to kMinSize and
+ * then of growing sizes, checks their contents and invariants, and checks
+ * that both still hold under inserts and erases.
+ */
+template <template <typename, typename> class BST> void testFromSorted() {
+  static std::mt19937 rng(time(NULL) / 11);
+  for (size_t n = 0; n <= kMaxSize; n = n < kMinSize ? n + 1 : n << 1) {
+    std::map<uint32_t, uint32_t> map;
+    while (map.size() < n) {
+      map[rng()] = rng();
+    }
+    auto tree = BST<uint32_t, uint32_t>::fromSorted(map.begin(), map.end());
+    ASSERT_EQ(tree.size(), map.size());
+    ASSERT_TRUE(isBst(tree));
+    ASSERT_TRUE(checkInvariants(tree));
+    for (const auto &i : map) {
+      ASSERT_EQ(*tree.find(i.first), i.second);
+    }
+
+    const size_t checkEvery = std::max<size_t>(1, n / kMaxChecked);
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t key = rng();
+      tree.emplace(key, i);
+      map[key] = i;
+      if (i % 2) {
+        ASSERT_EQ(tree.erase(map.begin()->first), true);
+        map.erase(map.begin());
+      }
+      if (i % checkEvery == 0) {
+        ASSERT_TRUE(checkInvariants(tree));
+      }
+    }
+    ASSERT_EQ(tree.size(), map.size());
+    ASSERT_TRUE(isBst(tree));
+    ASSERT_TRUE(checkInvariants(tree));
+    for (const auto &i : map) {
+      ASSERT_EQ(*tree.find(i.first), i.second);
+    }
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> unsorted = {{1, 1}, {3, 3},
+                                                         {2, 2}};
+  typedef BST<uint32_t, uint32_t> tree_t;
+  ASSERT_THROW(tree_t::fromSorted(unsorted.begin(), unsorted.end()),
+               std::runtime_error);
+}
 } // namespace tests
 } // namespace falcon
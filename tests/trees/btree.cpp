@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+
+#include "falcon/trees/btree.h"
+#include "tests/trees/bst_base.h"
+
+#include "gtest/gtest.h"
+
+using namespace falcon;
+using namespace falcon::tests;
+
+// 64 byte nodes hold only a few keys, so even small trees are several levels
+// deep and every kind of split is exercised.
+template <class Key, class Val> using SmallBTree = BTree<Key, Val, 64>;
+
+TEST(BTree, Simple) {
+  simpleTest<BTree>();
+  simpleTest<SmallBTree>();
+}
+
+TEST(BTree, Test) {
+  testInsert<BTree>();
+  testInsert<SmallBTree>();
+}
+
+TEST(BTree, Traverse) {
+  auto [tree, map] = testCase<SmallBTree>(kMaxSize);
+  auto traversal = tree.traverse<InOrder>();
+  ASSERT_TRUE(std::equal(traversal.begin(), traversal.end(), map.begin(),
+                         map.end(), [](const auto &a, const auto &b) {
+                           return a.first == b.first && a.second == b.second;
+                         }));
+}
+
+TEST(BTree, Range) {
+  testRange<BTree>();
+  testRange<SmallBTree>();
+}
+
+TEST(BTree, Strings) {
+  // Strings are not trivially destructible, so clearing and destroying the
+  // tree goes through the recursive destroy; with 64 byte nodes every node
+  // holds the minimum of 4 of them.
+  static std::mt19937 rng(time(NULL));
+  BTree<std::string, std::string, 64> tree;
+  std::map<std::string, std::string> map;
+  for (size_t i = 0; i < kMaxSize; ++i) {
+    // Long enough to live on the heap rather than in the string itself.
+    auto key = std::to_string(rng()) + std::string(32, 'k');
+    auto val = std::to_string(rng()) + std::string(32, 'v');
+    tree.emplace(key, val);
+    map[key] = val;
+  }
+  auto sameEntry = [](const auto &a, const auto &b) {
+    return a.first == b.first && a.second == b.second;
+  };
+  ASSERT_EQ(tree.size(), map.size());
+  ASSERT_TRUE(std::equal(tree.begin(), tree.end(), map.begin(), map.end(),
+                         sameEntry));
+
+  const auto &[first, firstVal] = *std::next(map.begin(), map.size() / 4);
+  const auto &[last, lastVal] = *std::next(map.begin(), map.size() / 2);
+  auto range = tree.range(first, last);
+  ASSERT_TRUE(std::equal(range.begin(), range.end(), map.lower_bound(first),
+                         map.lower_bound(last), sameEntry));
+
+  auto moved = std::move(tree);
+  ASSERT_EQ(tree.size(), 0);
+  ASSERT_EQ(*moved.find(first), firstVal);
+  moved.clear();
+  ASSERT_EQ(moved.find(first), nullptr);
+  moved.emplace(last, lastVal);
+  ASSERT_EQ(*moved.find(last), lastVal);
+}
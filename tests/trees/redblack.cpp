@@ -9,3 +9,21 @@ using namespace falcon::tests;
 TEST(RedBlackTree, Simple) { simpleTest<RBTree>(); }
 
 TEST(RedBlackTree, Test) { testInsert<RBTree>(); }
+
+TEST(RedBlackTree, Erase) { testErase<RBTree>(); }
+
+TEST(RedBlackTree, Handles) { testHandles<RBTree>(); }
+
+TEST(RedBlackTree, Range) { testRange<RBTree>(); }
+
+TEST(RedBlackTree, FromSorted) { testFromSorted<RBTree>(); }
+
+template <class Key, class Val>
+using RBTreeOrderStats = RBTree<Key, Val, NodeArena, true>;
+
+TEST(RedBlackTree, OrderStats) {
+  testErase<RBTreeOrderStats>();
+  testRange<RBTreeOrderStats>();
+  testOrderStats<RBTreeOrderStats>();
+  testFromSorted<RBTreeOrderStats>();
+}
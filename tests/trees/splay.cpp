@@ -9,3 +9,18 @@ using namespace falcon::tests;
 TEST(SplayTree, Simple) { simpleTest<SplayTree>(); }
 
 TEST(SplayTree, Test) { testInsert<SplayTree>(); }
+
+TEST(SplayTree, Erase) { testErase<SplayTree>(); }
+
+TEST(SplayTree, Handles) { testHandles<SplayTree>(); }
+
+TEST(SplayTree, Range) { testRange<SplayTree>(); }
+
+template <class Key, class Val>
+using SplayTreeOrderStats = SplayTree<Key, Val, NodeArena, true>;
+
+TEST(SplayTree, OrderStats) {
+  testErase<SplayTreeOrderStats>();
+  testRange<SplayTreeOrderStats>();
+  testOrderStats<SplayTreeOrderStats>();
+}
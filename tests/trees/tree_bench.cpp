@@ -0,0 +1,100 @@
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "falcon/io/csv.h"
+#include "falcon/trees/avl.h"
+#include "falcon/trees/btree.h"
+#include "falcon/trees/redblack.h"
+#include "falcon/trees/splay.h"
+
+using namespace falcon;
+
+constexpr size_t kMinKeys = 1 << 16;
+constexpr size_t kMaxKeys = 1 << 22;
+constexpr size_t kLookups = 1 << 22;
+
+template <class F> double mopsPerSec(size_t nOps, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return nOps / elapsed.count();
+}
+
+/**
+ * Inserts keys, then looks up kLookups of them in random order and scans
+ * the whole tree in order.
+ */
+template <class Tree>
+void bench(Csv<std::ostream> &writer, const std::string &name,
+           const std::vector<uint32_t> &keys,
+           const std::vector<uint32_t> &lookups) {
+  Tree tree;
+  uint64_t sum = 0;
+
+  auto insert = mopsPerSec(keys.size(), [&]() {
+    for (auto k : keys) {
+      tree.emplace(k, k);
+    }
+  });
+  auto find = mopsPerSec(lookups.size(), [&]() {
+    for (auto k : lookups) {
+      if constexpr (std::is_same_v<Tree, std::map<uint32_t, uint32_t>>) {
+        sum += tree.find(k)->second;
+      } else {
+        sum += *tree.find(k);
+      }
+    }
+  });
+  auto scan = mopsPerSec(tree.size(), [&]() {
+    if constexpr (std::is_same_v<Tree, std::map<uint32_t, uint32_t>>) {
+      for (const auto &p : tree) {
+        sum += p.second;
+      }
+    } else {
+      for (const auto &p : tree.template traverse<InOrder>()) {
+        sum += p.second;
+      }
+    }
+  });
+
+  writer.writeRow(name, keys.size(), insert, find, scan, sum);
+}
+
+/**
+ * Compares the BST family, BTree, and std::map on random uint32 keys.
+ */
+int main() {
+  Csv writer(std::cout);
+  writer.writeRow("Tree", "Keys", "Insert Mops/s", "Find Mops/s",
+                  "Scan Mkeys/s", "Checksum");
+
+  std::mt19937 rng;
+  rng.seed(std::time(NULL));
+  for (size_t n = kMinKeys; n <= kMaxKeys; n <<= 2) {
+    std::vector<uint32_t> keys(n);
+    for (auto &k : keys) {
+      k = rng();
+    }
+    std::vector<uint32_t> lookups(kLookups);
+    for (auto &k : lookups) {
+      k = keys[rng() % n];
+    }
+
+    bench<std::map<uint32_t, uint32_t>>(writer, "std::map", keys, lookups);
+    bench<AVLTree<uint32_t, uint32_t>>(writer, "AVLTree", keys, lookups);
+    bench<RBTree<uint32_t, uint32_t>>(writer, "RBTree", keys, lookups);
+    bench<SplayTree<uint32_t, uint32_t>>(writer, "SplayTree", keys, lookups);
+    bench<BTree<uint32_t, uint32_t>>(writer, "BTree", keys, lookups);
+    bench<BTree<uint32_t, uint32_t, 512>>(writer, "BTree 512B", keys,
+                                          lookups);
+  }
+
+  return 0;
+}